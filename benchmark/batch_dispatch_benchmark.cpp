@@ -0,0 +1,115 @@
+/*
+ * @Description: DispatchAll vs an element-by-element Dispatch loop
+ * @Author: lize
+ * @Date: 2025-10-29
+ * @LastEditors: lize
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "batch_dispatch.h"
+#include "benchmark/benchmark.h"
+
+namespace lz {
+namespace bc {
+
+template <int I>
+struct Shape {
+  int64_t Area() const {
+    return side * side * (I + 1) + I;
+  }
+  int64_t side = 3;
+};
+using ShapePointer =
+  Taggedpointer::TaggedPointer<Shape<0>, Shape<1>, Shape<2>, Shape<3>>;
+
+// state.range(1): 0 random tags, 1 tags already sorted
+class ShapeSet {
+ public:
+  ShapeSet(std::size_t count, bool sorted)
+    : _s0(count), _s1(count), _s2(count), _s3(count) {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(0, 3);
+    for (std::size_t i = 0; i < count; ++i) {
+      switch (dist(gen)) {
+        case 0:
+          _handles.emplace_back(&_s0[i]);
+          break;
+        case 1:
+          _handles.emplace_back(&_s1[i]);
+          break;
+        case 2:
+          _handles.emplace_back(&_s2[i]);
+          break;
+        default:
+          _handles.emplace_back(&_s3[i]);
+      }
+    }
+    if (sorted) {
+      std::stable_sort(
+        _handles.begin(), _handles.end(), [](auto lhs, auto rhs) {
+          return lhs.Index() < rhs.Index();
+        });
+    }
+  }
+  std::vector<ShapePointer>& handles() {
+    return _handles;
+  }
+
+ private:
+  std::vector<Shape<0>> _s0;
+  std::vector<Shape<1>> _s1;
+  std::vector<Shape<2>> _s2;
+  std::vector<Shape<3>> _s3;
+  std::vector<ShapePointer> _handles;
+};
+
+static void batch_element_loop(benchmark::State& state) {
+  ShapeSet set(state.range(0), state.range(1));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& handle : set.handles()) {
+      handle.Dispatch([&sum](auto ptr) { sum += ptr->Area(); });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void batch_dispatch_all_keep(benchmark::State& state) {
+  ShapeSet set(state.range(0), state.range(1));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    Taggedpointer::DispatchAll(
+      set.handles(),
+      [&sum](auto ptr) { sum += ptr->Area(); },
+      Taggedpointer::BatchOrder::Keep);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// the first pass partitions the container, so every later iteration sees
+// grouped input: this is the amortized cost of repeated passes.
+static void batch_dispatch_all_partition(benchmark::State& state) {
+  ShapeSet set(state.range(0), state.range(1));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    Taggedpointer::DispatchAll(set.handles(),
+                               [&sum](auto ptr) { sum += ptr->Area(); });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(batch_element_loop)
+  ->ArgsProduct({{1 << 10, 1 << 16, 1 << 20}, {0, 1}});
+BENCHMARK(batch_dispatch_all_keep)
+  ->ArgsProduct({{1 << 10, 1 << 16, 1 << 20}, {0, 1}});
+BENCHMARK(batch_dispatch_all_partition)
+  ->ArgsProduct({{1 << 10, 1 << 16, 1 << 20}, {0, 1}});
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,144 @@
+/*
+ * @Description: B+tree vs arena RBTree on the same ordered-set workload
+ * @Author: lize
+ * @Date: 2025-11-06
+ * @LastEditors: lize
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "utils/btree.h"
+#include "utils/rbtree.h"
+
+namespace lz {
+namespace bc {
+template <typename Value>
+using BTree = btree::BTree<Value>;
+template <typename Value>
+using RBTree = rbtree::RBTree<Value>;
+
+// range(0) distinct keys in random order
+template <typename Value>
+static std::vector<Value> randomKeys(int64_t count) {
+  std::vector<Value> keys(count);
+  std::mt19937_64 gen(42);
+  for (int64_t i = 0; i < count; ++i) {
+    if constexpr (std::is_same_v<Value, std::string>) {
+      keys[i] = "key:" + std::to_string(i * 7919);
+    } else {
+      keys[i] = static_cast<Value>(i * 7919);
+    }
+  }
+  std::shuffle(keys.begin(), keys.end(), gen);
+  return keys;
+}
+
+template <typename Tree, typename Value>
+static void fill(Tree& tree, const std::vector<Value>& keys) {
+  for (auto& key : keys) {
+    tree.insert(key);
+  }
+}
+
+template <template <typename> class Tree, typename Value>
+static void ordered_insert(benchmark::State& state) {
+  auto keys = randomKeys<Value>(state.range(0));
+  for (auto _ : state) {
+    Tree<Value> tree;
+    fill(tree, keys);
+    state.counters["bytes/key"] =
+      static_cast<double>(tree.bytes()) / keys.size();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <template <typename> class Tree, typename Value>
+static void ordered_find(benchmark::State& state) {
+  auto keys = randomKeys<Value>(state.range(0));
+  Tree<Value> tree;
+  fill(tree, keys);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+  for (auto _ : state) {
+    int64_t found = 0;
+    for (auto& key : keys) {
+      found += tree.find(key) != nullptr;
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// removes half the keys and puts them back
+template <template <typename> class Tree, typename Value>
+static void ordered_churn(benchmark::State& state) {
+  auto keys = randomKeys<Value>(state.range(0));
+  Tree<Value> tree;
+  fill(tree, keys);
+  keys.resize(keys.size() / 2);
+  for (auto _ : state) {
+    for (auto& key : keys) {
+      tree.remove(key);
+    }
+    for (auto& key : keys) {
+      tree.insert(key);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size() * 2);
+}
+
+// 1000 scans of 1000 consecutive keys each
+template <template <typename> class Tree, typename Value>
+static void ordered_scan(benchmark::State& state) {
+  auto keys = randomKeys<Value>(state.range(0));
+  Tree<Value> tree;
+  fill(tree, keys);
+  std::vector<Value> sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+  std::mt19937 gen(9);
+  std::uniform_int_distribution<std::size_t> start(0, sorted.size() - 1001);
+  for (auto _ : state) {
+    int64_t visited = 0;
+    for (int i = 0; i < 1000; ++i) {
+      std::size_t lo = start(gen);
+      visited += tree.for_each_in_range(
+        sorted[lo], sorted[lo + 1000], [](const Value& v) {
+          benchmark::DoNotOptimize(v);
+        });
+    }
+    benchmark::DoNotOptimize(visited);
+  }
+  state.SetItemsProcessed(state.iterations() * 1000 * 1000);
+}
+
+#define ORDERED_SIZES      \
+  Arg(1 << 16)             \
+    ->Arg(1 << 20)         \
+    ->Arg(1 << 23)         \
+    ->Unit(benchmark::kMillisecond)
+
+#define ORDERED_CASES(op)                                        \
+  BENCHMARK_TEMPLATE(op, BTree, int32_t)->ORDERED_SIZES;         \
+  BENCHMARK_TEMPLATE(op, RBTree, int32_t)->ORDERED_SIZES;        \
+  BENCHMARK_TEMPLATE(op, BTree, uint64_t)->ORDERED_SIZES;        \
+  BENCHMARK_TEMPLATE(op, RBTree, uint64_t)->ORDERED_SIZES;       \
+  BENCHMARK_TEMPLATE(op, BTree, std::string)->Arg(1 << 20)->Unit( \
+    benchmark::kMillisecond);                                    \
+  BENCHMARK_TEMPLATE(op, RBTree, std::string)->Arg(1 << 20)->Unit( \
+    benchmark::kMillisecond)
+
+ORDERED_CASES(ordered_insert);
+ORDERED_CASES(ordered_find);
+ORDERED_CASES(ordered_churn);
+ORDERED_CASES(ordered_scan);
+
+#undef ORDERED_CASES
+#undef ORDERED_SIZES
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,161 @@
+/*
+ * @Description: O(1) Dispatch vs the || fold, 2 to 64 types
+ * @Author: lize
+ * @Date: 2025-10-26
+ * @LastEditors: lize
+ */
+
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "region_tag_policy.h"
+#include "taggedpointer.h"
+#include "unique_taggedpointer.h"
+
+namespace lz {
+namespace bc {
+
+template <std::size_t I>
+struct Kind {
+  int64_t Get() const {
+    return value + static_cast<int64_t>(I);
+  }
+  int64_t value = 1;
+};
+
+template <typename Seq>
+struct KindList;
+template <std::size_t... Is>
+struct KindList<std::index_sequence<Is...>> {
+  using Pointer = Taggedpointer::TaggedPointer<Kind<Is>...>;
+  using Objects = std::tuple<Kind<Is>...>;
+  static std::vector<Pointer> Pool(Objects& objects) {
+    return {Pointer(&std::get<Is>(objects))...};
+  }
+};
+
+// one object of every kind and a shuffled list of handles to them, so the
+// tag sequence is unpredictable for the branch predictor.
+template <std::size_t N>
+class KindSet {
+  using List = KindList<std::make_index_sequence<N>>;
+
+ public:
+  explicit KindSet(std::size_t count) {
+    auto pool = List::Pool(_objects);
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> dist(0, N - 1);
+    _handles.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      _handles.push_back(pool[dist(gen)]);
+    }
+  }
+  std::vector<typename List::Pointer>& handles() {
+    return _handles;
+  }
+
+ private:
+  typename List::Objects _objects;
+  std::vector<typename List::Pointer> _handles;
+};
+
+template <std::size_t N>
+static void dispatch_fold(benchmark::State& state) {
+  KindSet<N> set(state.range(0));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& handle : set.handles()) {
+      handle.DispatchFold([&sum](auto ptr) { sum += ptr->Get(); });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <std::size_t N>
+static void dispatch(benchmark::State& state) {
+  KindSet<N> set(state.range(0));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& handle : set.handles()) {
+      handle.Dispatch([&sum](auto ptr) { sum += ptr->Get(); });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <std::size_t N>
+static void dispatch_return(benchmark::State& state) {
+  KindSet<N> set(state.range(0));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& handle : set.handles()) {
+      sum += handle.Dispatch([](auto ptr) { return ptr->Get(); });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// the same visit with the type taken from the address range instead of the
+// high bits; objects come from the per-type pools either way.
+template <typename Policy>
+static void dispatch_policy(benchmark::State& state) {
+  using Pointer =
+    Taggedpointer::TaggedPointer<Policy, Kind<0>, Kind<1>, Kind<2>, Kind<3>>;
+  using Owned = Taggedpointer::UniqueTaggedPointer<Pointer>;
+  std::vector<Owned> owners;
+  std::vector<Pointer> handles;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, 3);
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    switch (dist(gen)) {
+      case 0:
+        owners.push_back(Owned::template Make<Kind<0>>());
+        break;
+      case 1:
+        owners.push_back(Owned::template Make<Kind<1>>());
+        break;
+      case 2:
+        owners.push_back(Owned::template Make<Kind<2>>());
+        break;
+      default:
+        owners.push_back(Owned::template Make<Kind<3>>());
+    }
+    handles.push_back(owners.back().get());
+  }
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& handle : handles) {
+      sum += handle.Dispatch([](auto ptr) { return ptr->Get(); });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(dispatch_fold, 2)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch, 2)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_return, 2)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_fold, 7)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch, 7)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_return, 7)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_fold, 16)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch, 16)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_return, 16)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_fold, 64)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch, 64)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_return, 64)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(dispatch_policy, Taggedpointer::BitTagPolicy)
+  ->Arg(1 << 12)
+  ->Arg(1 << 20);
+BENCHMARK_TEMPLATE(dispatch_policy, Taggedpointer::RegionTagPolicy<>)
+  ->Arg(1 << 12)
+  ->Arg(1 << 20);
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,343 @@
+/*
+ * @Description: TaggedPointer vs virtual vs std::variant vs function tables
+ * @Author: lize
+ * @Date: 2025-11-02
+ * @LastEditors: lize
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "batch_dispatch.h"
+#include "benchmark/benchmark.h"
+#include "taggedpointer.h"
+#include "unique_taggedpointer.h"
+
+// every approach holds n objects spread over N types and answers the same
+// three questions:
+//   construct  build n objects and their handles, then drop them
+//   dispatch   one call at a time, each index derived from the last result,
+//              so calls do not overlap (latency)
+//   iterate    one linear pass over all handles (throughput)
+// the template arguments sweep the type count and the tag spread; the range
+// sweeps n from L1-sized to DRAM-sized working sets, and Complexity() fits
+// each family so a regression shows up as a changed coefficient.
+namespace lz {
+namespace bc {
+
+template <std::size_t I>
+struct Kind {
+  int64_t Get() const {
+    return value + static_cast<int64_t>(I);
+  }
+  int64_t value = 1;
+};
+
+struct Base {
+  virtual ~Base() = default;
+  virtual int64_t Get() const = 0;
+};
+template <std::size_t I>
+struct VirtualKind : Base {
+  int64_t Get() const override {
+    return value + static_cast<int64_t>(I);
+  }
+  int64_t value = 1;
+};
+
+enum class Spread : uint8_t {
+  Uniform,
+  // type i with probability 2^-(i+1): a few hot types
+  Skewed,
+  // uniform, but grouped by type, so the tag sequence is predictable
+  Sorted,
+};
+
+template <std::size_t N>
+static std::vector<uint8_t> makeKinds(std::size_t count, Spread spread) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::size_t> uniform(0, N - 1);
+  std::geometric_distribution<std::size_t> geometric(0.5);
+  std::vector<uint8_t> kinds(count);
+  for (auto& kind : kinds) {
+    kind = spread == Spread::Skewed ? std::min(geometric(gen), N - 1)
+                                    : uniform(gen);
+  }
+  if (spread == Spread::Sorted) {
+    std::sort(kinds.begin(), kinds.end());
+  }
+  return kinds;
+}
+
+// calls func(integral_constant<I>) for a runtime kind; construction goes
+// through this for every approach alike.
+template <typename Func, std::size_t... Is>
+static void withKind(std::size_t kind, Func& func, std::index_sequence<Is...>) {
+  using Thunk = void (*)(Func&);
+  static constexpr Thunk table[] = {[](Func& f) {
+    f(std::integral_constant<std::size_t, Is>{});
+  }...};
+  table[kind](func);
+}
+
+template <typename Seq>
+struct Approaches;
+template <std::size_t... Is>
+struct Approaches<std::index_sequence<Is...>> {
+  static constexpr auto kIndices = std::index_sequence<Is...>{};
+
+  class Tagged {
+    using Pointer = Taggedpointer::TaggedPointer<Kind<Is>...>;
+    using Owned = Taggedpointer::UniqueTaggedPointer<Pointer>;
+
+   public:
+    void build(const std::vector<uint8_t>& kinds) {
+      _owners.reserve(kinds.size());
+      _handles.reserve(kinds.size());
+      for (auto kind : kinds) {
+        auto make =
+          [this]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+            _owners.push_back(Owned::template Make<Kind<I>>());
+            _handles.push_back(_owners.back().get());
+          };
+        withKind(kind, make, kIndices);
+      }
+    }
+    void clear() {
+      _handles.clear();
+      _owners.clear();
+    }
+    int64_t call(std::size_t i) {
+      return _handles[i].Dispatch([](auto ptr) { return ptr->Get(); });
+    }
+    int64_t sum() {
+      int64_t sum = 0;
+      for (auto& handle : _handles) {
+        sum += handle.Dispatch([](auto ptr) { return ptr->Get(); });
+      }
+      return sum;
+    }
+    // the same pass grouped by type with DispatchAll
+    int64_t sumBatched() {
+      int64_t sum = 0;
+      Taggedpointer::DispatchAll(
+        _handles,
+        [&sum](auto ptr) { sum += ptr->Get(); },
+        Taggedpointer::BatchOrder::Keep);
+      return sum;
+    }
+
+   private:
+    std::vector<Owned> _owners;
+    std::vector<Pointer> _handles;
+  };
+
+  class Virtual {
+   public:
+    void build(const std::vector<uint8_t>& kinds) {
+      _objects.reserve(kinds.size());
+      for (auto kind : kinds) {
+        auto make =
+          [this]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+            _objects.push_back(std::make_unique<VirtualKind<I>>());
+          };
+        withKind(kind, make, kIndices);
+      }
+    }
+    void clear() {
+      _objects.clear();
+    }
+    int64_t call(std::size_t i) {
+      return _objects[i]->Get();
+    }
+    int64_t sum() {
+      int64_t sum = 0;
+      for (auto& object : _objects) {
+        sum += object->Get();
+      }
+      return sum;
+    }
+
+   private:
+    std::vector<std::unique_ptr<Base>> _objects;
+  };
+
+  // objects stored by value, the way std::variant is normally used
+  class Variant {
+    using Value = std::variant<Kind<Is>...>;
+
+   public:
+    void build(const std::vector<uint8_t>& kinds) {
+      _values.reserve(kinds.size());
+      for (auto kind : kinds) {
+        auto make =
+          [this]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+            _values.emplace_back(std::in_place_index<I>);
+          };
+        withKind(kind, make, kIndices);
+      }
+    }
+    void clear() {
+      _values.clear();
+    }
+    int64_t call(std::size_t i) {
+      return std::visit([](auto& value) { return value.Get(); }, _values[i]);
+    }
+    int64_t sum() {
+      int64_t sum = 0;
+      for (auto& value : _values) {
+        sum += std::visit([](auto& v) { return v.Get(); }, value);
+      }
+      return sum;
+    }
+
+   private:
+    std::vector<Value> _values;
+  };
+
+  // a hand-written tag + void* pair and a table of functions per operation
+  class Table {
+    struct Entry {
+      void* object;
+      uint32_t kind;
+    };
+    using GetFn = int64_t (*)(const void*);
+    using DeleteFn = void (*)(void*);
+    static constexpr GetFn kGet[] = {[](const void* object) {
+      return static_cast<const Kind<Is>*>(object)->Get();
+    }...};
+    static constexpr DeleteFn kDelete[] = {
+      [](void* object) { delete static_cast<Kind<Is>*>(object); }...};
+
+   public:
+    ~Table() {
+      clear();
+    }
+    void build(const std::vector<uint8_t>& kinds) {
+      _entries.reserve(kinds.size());
+      for (auto kind : kinds) {
+        auto make =
+          [this]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+            _entries.push_back({new Kind<I>(), static_cast<uint32_t>(I)});
+          };
+        withKind(kind, make, kIndices);
+      }
+    }
+    void clear() {
+      for (auto& entry : _entries) {
+        kDelete[entry.kind](entry.object);
+      }
+      _entries.clear();
+    }
+    int64_t call(std::size_t i) {
+      return kGet[_entries[i].kind](_entries[i].object);
+    }
+    int64_t sum() {
+      int64_t sum = 0;
+      for (auto& entry : _entries) {
+        sum += kGet[entry.kind](entry.object);
+      }
+      return sum;
+    }
+
+   private:
+    std::vector<Entry> _entries;
+  };
+};
+
+template <std::size_t N>
+using With = Approaches<std::make_index_sequence<N>>;
+
+template <typename Set, std::size_t N, Spread S>
+static void suite_construct(benchmark::State& state) {
+  auto kinds = makeKinds<N>(state.range(0), S);
+  Set set;
+  for (auto _ : state) {
+    set.build(kinds);
+    benchmark::ClobberMemory();
+    set.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetComplexityN(state.range(0));
+}
+
+template <typename Set, std::size_t N, Spread S>
+static void suite_dispatch(benchmark::State& state) {
+  auto kinds = makeKinds<N>(state.range(0), S);
+  Set set;
+  set.build(kinds);
+  // n is a power of two; a full-period LCG step whose increment depends on
+  // the previous result, so each call waits for the one before
+  std::size_t mask = state.range(0) - 1;
+  for (auto _ : state) {
+    std::size_t i = 0;
+    int64_t sum = 0;
+    for (int64_t step = 0; step < state.range(0); ++step) {
+      int64_t value = set.call(i);
+      sum += value;
+      i = (i * 5 + 1 + 2 * (value & 1)) & mask;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetComplexityN(state.range(0));
+}
+
+template <typename Set, std::size_t N, Spread S>
+static void suite_iterate(benchmark::State& state) {
+  auto kinds = makeKinds<N>(state.range(0), S);
+  Set set;
+  set.build(kinds);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(set.sum());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetComplexityN(state.range(0));
+}
+
+template <std::size_t N, Spread S>
+static void suite_iterate_batched(benchmark::State& state) {
+  auto kinds = makeKinds<N>(state.range(0), S);
+  typename With<N>::Tagged set;
+  set.build(kinds);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(set.sumBatched());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetComplexityN(state.range(0));
+}
+
+// 1K..4M objects: from L1 to well past the last-level cache
+#define SUITE_SIZES \
+  RangeMultiplier(8)->Range(1 << 10, 1 << 22)->Complexity(benchmark::oN)
+
+#define SUITE_APPROACHES(Op, N, S)                                       \
+  BENCHMARK_TEMPLATE(Op, With<N>::Tagged, N, Spread::S)->SUITE_SIZES;  \
+  BENCHMARK_TEMPLATE(Op, With<N>::Virtual, N, Spread::S)->SUITE_SIZES; \
+  BENCHMARK_TEMPLATE(Op, With<N>::Variant, N, Spread::S)->SUITE_SIZES; \
+  BENCHMARK_TEMPLATE(Op, With<N>::Table, N, Spread::S)->SUITE_SIZES;
+
+#define SUITE(N, S)                        \
+  SUITE_APPROACHES(suite_construct, N, S) \
+  SUITE_APPROACHES(suite_dispatch, N, S)  \
+  SUITE_APPROACHES(suite_iterate, N, S)   \
+  BENCHMARK_TEMPLATE(suite_iterate_batched, N, Spread::S)->SUITE_SIZES;
+
+// the tag spread at 8 types, then the type count with uniform tags
+SUITE(8, Uniform)
+SUITE(8, Skewed)
+SUITE(8, Sorted)
+SUITE(2, Uniform)
+SUITE(32, Uniform)
+
+#undef SUITE
+#undef SUITE_APPROACHES
+#undef SUITE_SIZES
+
+}  // namespace bc
+}  // namespace lz
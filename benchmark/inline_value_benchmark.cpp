@@ -0,0 +1,168 @@
+/*
+ * @Description: inline NaN-boxed values vs std::variant vs heap boxing
+ * @Author: lize
+ * @Date: 2025-11-01
+ * @LastEditors: lize
+ */
+
+#include <memory>
+#include <random>
+#include <variant>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nanbox_tag_policy.h"
+#include "taggedpointer.h"
+
+namespace lz {
+namespace bc {
+using Taggedpointer::Inline;
+
+using Boxed = Taggedpointer::
+  TaggedPointer<Taggedpointer::NanBoxTagPolicy, Inline<int64_t>,
+                Inline<double>, Inline<bool>>;
+using Variant = std::variant<int64_t, double, bool>;
+
+// the status quo: every scalar in its own heap object
+struct IntBox {
+  int64_t value;
+};
+struct DoubleBox {
+  double value;
+};
+struct BoolBox {
+  bool value;
+};
+using Heap = Taggedpointer::TaggedPointer<IntBox, DoubleBox, BoolBox>;
+
+// the same shuffled mix of kinds for every benchmark: 0 int, 1 double, 2 bool
+static std::vector<int> kinds(int64_t n) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> pick(0, 2);
+  std::vector<int> result(n);
+  for (auto& kind : result) {
+    kind = pick(rng);
+  }
+  return result;
+}
+
+struct Sum {
+  double operator()(int64_t v) const {
+    return static_cast<double>(v);
+  }
+  double operator()(double v) const {
+    return v;
+  }
+  double operator()(bool v) const {
+    return v;
+  }
+  double operator()(IntBox* v) const {
+    return static_cast<double>(v->value);
+  }
+  double operator()(DoubleBox* v) const {
+    return v->value;
+  }
+  double operator()(BoolBox* v) const {
+    return v->value;
+  }
+};
+
+template <typename Value>
+static Value make(int kind, int64_t i);
+template <>
+Boxed make<Boxed>(int kind, int64_t i) {
+  if (kind == 0) {
+    return i;
+  }
+  if (kind == 1) {
+    return 0.5 * static_cast<double>(i);
+  }
+  return (i & 1) != 0;
+}
+template <>
+Variant make<Variant>(int kind, int64_t i) {
+  if (kind == 0) {
+    return i;
+  }
+  if (kind == 1) {
+    return 0.5 * static_cast<double>(i);
+  }
+  return (i & 1) != 0;
+}
+template <>
+Heap make<Heap>(int kind, int64_t i) {
+  if (kind == 0) {
+    return new IntBox{i};
+  }
+  if (kind == 1) {
+    return new DoubleBox{0.5 * static_cast<double>(i)};
+  }
+  return new BoolBox{(i & 1) != 0};
+}
+
+static void release(std::vector<Heap>& values) {
+  for (auto& value : values) {
+    value.Dispatch([](auto ptr) { delete ptr; });
+  }
+}
+static void release(std::vector<Boxed>&) {
+}
+static void release(std::vector<Variant>&) {
+}
+
+static double visit(Boxed& value) {
+  return value.Dispatch(Sum{});
+}
+static double visit(Heap& value) {
+  return value.Dispatch(Sum{});
+}
+static double visit(Variant& value) {
+  return std::visit(Sum{}, value);
+}
+
+// fill a vector of n values, then drop them
+template <typename Value>
+static void inline_build(benchmark::State& state) {
+  auto mix = kinds(state.range(0));
+  std::vector<Value> values;
+  values.reserve(mix.size());
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      values.push_back(make<Value>(mix[i], i));
+    }
+    benchmark::DoNotOptimize(values.data());
+    release(values);
+    values.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["bytes/value"] = sizeof(Value);
+}
+
+// read every value back through its visitor
+template <typename Value>
+static void inline_sum(benchmark::State& state) {
+  auto mix = kinds(state.range(0));
+  std::vector<Value> values;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    values.push_back(make<Value>(mix[i], i));
+  }
+  for (auto _ : state) {
+    double sum = 0;
+    for (auto& value : values) {
+      sum += visit(value);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  release(values);
+}
+
+BENCHMARK(inline_build<Boxed>)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(inline_build<Variant>)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(inline_build<Heap>)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(inline_sum<Boxed>)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(inline_sum<Variant>)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(inline_sum<Heap>)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,174 @@
+/*
+ * @Description: path-copying snapshots vs the mutex RBTree under writers
+ * and whole-tree readers
+ * @Author: lize
+ * @Date: 2025-11-08
+ * @LastEditors: lize
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "utils/persistent_rbtree.h"
+#include "utils/rbtree.h"
+
+namespace lz {
+namespace bc {
+constexpr int kKeys = 1 << 20;
+
+// the two trees behind one interface: point reads and whole-tree scans
+struct Locked {
+  rbtree::RBTree<int> tree;
+  bool find(int key) const {
+    return tree.find(key) != nullptr;
+  }
+  // holds the mutex for the whole scan
+  std::size_t scan() const {
+    return tree.for_each_in_range(
+      std::numeric_limits<int>::min(),
+      std::numeric_limits<int>::max(),
+      [](int key) { benchmark::DoNotOptimize(key); });
+  }
+};
+struct Persistent {
+  rbtree::PersistentRBTree<int> tree;
+  bool find(int key) const {
+    return tree.snapshot().find(key) != nullptr;
+  }
+  std::size_t scan() const {
+    return tree.snapshot().for_each(
+      [](int key) { benchmark::DoNotOptimize(key); });
+  }
+};
+
+// even keys; writers toggle odd ones
+template <typename Tree>
+static Tree& filledTree() {
+  static Tree tree;
+  static bool filled = [] {
+    std::vector<int> keys(kKeys);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    for (int key : keys) {
+      tree.tree.insert(key * 2);
+    }
+    return true;
+  }();
+  (void)filled;
+  return tree;
+}
+
+template <typename Tree>
+static void toggle(Tree& tree, std::mt19937& gen) {
+  int key = static_cast<int>(gen() % kKeys) * 2 + 1;
+  if (!tree.tree.insert(key)) {
+    tree.tree.remove(key);
+  }
+}
+
+// one thread, inserts and removes only: the cost of copying the path
+template <typename Tree>
+static void mvcc_write(benchmark::State& state) {
+  auto& tree = filledTree<Tree>();
+  std::mt19937 gen(1);
+  for (auto _ : state) {
+    toggle(tree, gen);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// for a fixed wall time: one writer, range(0) point readers timing every
+// find, and, if range(1), one reader scanning the whole tree over and
+// over as a report would. reports the writer's rate, the readers' find
+// latency percentiles and the scans finished. a find that waits out a
+// whole locked scan is one sample, so look at the max as well as p999.
+template <typename Tree>
+static void mvcc_mixed(benchmark::State& state) {
+  using Clock = std::chrono::steady_clock;
+  auto& tree = filledTree<Tree>();
+  int readers = static_cast<int>(state.range(0));
+  bool scanner = state.range(1) != 0;
+  for (auto _ : state) {
+    std::atomic<bool> done{false};
+    std::atomic<int64_t> writes{0};
+    std::atomic<int64_t> scans{0};
+    std::vector<std::vector<int64_t>> latencies(readers);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+      std::mt19937 gen(2);
+      int64_t count = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        toggle(tree, gen);
+        ++count;
+      }
+      writes = count;
+    });
+    if (scanner) {
+      threads.emplace_back([&] {
+        while (!done.load(std::memory_order_relaxed)) {
+          benchmark::DoNotOptimize(tree.scan());
+          ++scans;
+        }
+      });
+    }
+    for (int r = 0; r < readers; ++r) {
+      threads.emplace_back([&, r] {
+        std::mt19937 gen(10 + r);
+        auto& samples = latencies[r];
+        samples.reserve(1 << 20);
+        while (!done.load(std::memory_order_relaxed)) {
+          int key = static_cast<int>(gen() % (2 * kKeys));
+          auto start = Clock::now();
+          benchmark::DoNotOptimize(tree.find(key));
+          samples.push_back((Clock::now() - start).count());
+        }
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    done = true;
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    std::vector<int64_t> all;
+    for (auto& samples : latencies) {
+      all.insert(all.end(), samples.begin(), samples.end());
+    }
+    auto percentile = [&](double p) {
+      if (all.empty()) {
+        return 0.0;
+      }
+      auto at = all.begin() + static_cast<std::size_t>(p * (all.size() - 1));
+      std::nth_element(all.begin(), at, all.end());
+      return static_cast<double>(*at);
+    };
+    state.counters["writes/s"] = static_cast<double>(writes);
+    state.counters["scans"] = static_cast<double>(scans);
+    state.counters["find_p50_ns"] = percentile(0.5);
+    state.counters["find_p99_ns"] = percentile(0.99);
+    state.counters["find_p999_ns"] = percentile(0.999);
+    state.counters["find_max_ns"] = percentile(1.0);
+  }
+}
+
+BENCHMARK_TEMPLATE(mvcc_write, Locked);
+BENCHMARK_TEMPLATE(mvcc_write, Persistent);
+
+#define MVCC_MIXED                                                        \
+  Args({2, 0})->Args({2, 1})->Iterations(1)->Unit(benchmark::kMillisecond) \
+    ->UseRealTime()
+
+BENCHMARK_TEMPLATE(mvcc_mixed, Locked)->MVCC_MIXED;
+BENCHMARK_TEMPLATE(mvcc_mixed, Persistent)->MVCC_MIXED;
+
+#undef MVCC_MIXED
+
+}  // namespace bc
+}  // namespace lz
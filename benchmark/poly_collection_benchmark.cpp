@@ -0,0 +1,146 @@
+/*
+ * @Description: PolyCollection::for_each vs heap objects behind handles
+ * @Author: lize
+ * @Date: 2025-10-30
+ * @LastEditors: lize
+ */
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "poly_collection.h"
+
+namespace lz {
+namespace bc {
+
+struct Base {
+  virtual ~Base() = default;
+  virtual int64_t Weight() const = 0;
+};
+template <int I>
+struct Particle : Base {
+  int64_t Weight() const override {
+    return mass * (I + 1);
+  }
+  int64_t mass = 2;
+  double position[3] = {};
+};
+
+using Collection = Taggedpointer::PolyCollection<Particle<0>,
+                                                 Particle<1>,
+                                                 Particle<2>,
+                                                 Particle<3>>;
+using Pointer = Collection::Pointer;
+
+static int pick(std::mt19937& gen) {
+  return std::uniform_int_distribution<int>(0, 3)(gen);
+}
+
+static void poly_for_each(benchmark::State& state) {
+  Collection collection;
+  std::mt19937 gen(3);
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    switch (pick(gen)) {
+      case 0:
+        collection.emplace<Particle<0>>();
+        break;
+      case 1:
+        collection.emplace<Particle<1>>();
+        break;
+      case 2:
+        collection.emplace<Particle<2>>();
+        break;
+      default:
+        collection.emplace<Particle<3>>();
+    }
+  }
+  for (auto _ : state) {
+    int64_t sum = 0;
+    // qualified call: only the concrete type's Weight, no virtual dispatch
+    collection.for_each([&sum](auto ptr) {
+      sum += ptr->std::remove_pointer_t<decltype(ptr)>::Weight();
+    });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void poly_heap_tagged(benchmark::State& state) {
+  std::vector<std::unique_ptr<Base>> owners;
+  std::vector<Pointer> handles;
+  std::mt19937 gen(3);
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    switch (pick(gen)) {
+      case 0: {
+        auto* p = new Particle<0>();
+        owners.emplace_back(p);
+        handles.emplace_back(p);
+        break;
+      }
+      case 1: {
+        auto* p = new Particle<1>();
+        owners.emplace_back(p);
+        handles.emplace_back(p);
+        break;
+      }
+      case 2: {
+        auto* p = new Particle<2>();
+        owners.emplace_back(p);
+        handles.emplace_back(p);
+        break;
+      }
+      default: {
+        auto* p = new Particle<3>();
+        owners.emplace_back(p);
+        handles.emplace_back(p);
+      }
+    }
+  }
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& handle : handles) {
+      handle.Dispatch([&sum](auto ptr) {
+        sum += ptr->std::remove_pointer_t<decltype(ptr)>::Weight();
+      });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void poly_heap_virtual(benchmark::State& state) {
+  std::vector<std::unique_ptr<Base>> owners;
+  std::mt19937 gen(3);
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    switch (pick(gen)) {
+      case 0:
+        owners.push_back(std::make_unique<Particle<0>>());
+        break;
+      case 1:
+        owners.push_back(std::make_unique<Particle<1>>());
+        break;
+      case 2:
+        owners.push_back(std::make_unique<Particle<2>>());
+        break;
+      default:
+        owners.push_back(std::make_unique<Particle<3>>());
+    }
+  }
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (auto& owner : owners) {
+      sum += owner->Weight();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(poly_for_each)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+BENCHMARK(poly_heap_tagged)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+BENCHMARK(poly_heap_virtual)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+}  // namespace bc
+}  // namespace lz
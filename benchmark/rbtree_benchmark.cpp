@@ -0,0 +1,474 @@
+/*
+ * @Description: arena RBTree vs the shared_ptr RBTree vs std::set
+ * @Author: lize
+ * @Date: 2025-11-03
+ * @LastEditors: lize
+ */
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "benchmark/benchmark.h"
+#include "utils/rbtree.h"
+#include "utils/shared_rbtree.h"
+
+namespace lz {
+namespace bc {
+using Arena = rbtree::RBTree<int>;
+using Shared = rbtree::SharedRBTree<int>;
+using Set = std::set<int>;
+
+// heap bytes in use, allocator overhead included; 0 where unknown
+static std::size_t heapBytes() {
+#ifdef __GLIBC__
+  auto info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+static std::vector<int> shuffledKeys(int64_t count) {
+  std::vector<int> keys(count);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+  return keys;
+}
+
+template <typename Tree>
+static bool contains(Tree& tree, int key) {
+  if constexpr (std::is_same_v<Tree, Set>) {
+    return tree.find(key) != tree.end();
+  } else {
+    return tree.find(key) != nullptr;
+  }
+}
+
+// random-order inserts into an empty tree; also reports the heap growth
+template <typename Tree>
+static void rbtree_insert(benchmark::State& state) {
+  auto keys = shuffledKeys(state.range(0));
+  double bytesPerNode = 0;
+  for (auto _ : state) {
+    std::size_t before = heapBytes();
+    auto tree = std::make_unique<Tree>();
+    for (int key : keys) {
+      tree->insert(key);
+    }
+    state.PauseTiming();
+    bytesPerNode = static_cast<double>(heapBytes() - before) / keys.size();
+    tree.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["bytes/node"] = bytesPerNode;
+}
+
+// every key once, in an order unrelated to insertion
+template <typename Tree>
+static void rbtree_find(benchmark::State& state) {
+  auto keys = shuffledKeys(state.range(0));
+  Tree tree;
+  for (int key : keys) {
+    tree.insert(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+  for (auto _ : state) {
+    int64_t found = 0;
+    for (int key : keys) {
+      found += contains(tree, key);
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// startup: a tree over range(0) sorted keys, one at a time or in O(n).
+// both include tearing the tree down, which is a few chunk frees.
+static void rbtree_build_inserts(benchmark::State& state) {
+  std::vector<int> keys(state.range(0));
+  std::iota(keys.begin(), keys.end(), 0);
+  for (auto _ : state) {
+    Arena tree;
+    for (int key : keys) {
+      tree.insert(key);
+    }
+    benchmark::DoNotOptimize(tree.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void rbtree_build_sorted(benchmark::State& state) {
+  std::vector<int> keys(state.range(0));
+  std::iota(keys.begin(), keys.end(), 0);
+  for (auto _ : state) {
+    auto tree = Arena::fromSorted(keys);
+    benchmark::DoNotOptimize(tree.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// range(1) random new keys into a tree of range(0) even keys, one insert
+// each or one insertBatch
+template <bool Batch>
+static void rbtree_insert_batch(benchmark::State& state) {
+  std::vector<int> keys(state.range(0));
+  for (int i = 0; i < state.range(0); ++i) {
+    keys[i] = i * 2;
+  }
+  std::vector<int> batch(state.range(1));
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> odd(0, state.range(0) - 1);
+  for (int& key : batch) {
+    key = odd(gen) * 2 + 1;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    {
+      auto tree = Arena::fromSorted(keys);
+      state.ResumeTiming();
+      if constexpr (Batch) {
+        tree.insertBatch(batch);
+      } else {
+        for (int key : batch) {
+          tree.insert(key);
+        }
+      }
+      state.PauseTiming();
+    }
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+// sums the keys in [lo, lo + range(0)) of a 1M-key tree, at random offsets
+enum class Scan { ForEach, Iterator, Set, SortedVector };
+
+template <Scan How>
+static void rbtree_range_scan(benchmark::State& state) {
+  constexpr int kKeys = 1 << 20;
+  auto keys = shuffledKeys(kKeys);
+  Arena tree;
+  Set set;
+  for (int key : keys) {
+    if constexpr (How == Scan::Set) {
+      set.insert(key);
+    } else {
+      tree.insert(key);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  int length = static_cast<int>(state.range(0));
+  std::mt19937 gen(9);
+  std::uniform_int_distribution<int> start(0, kKeys - length);
+  for (auto _ : state) {
+    int lo = start(gen);
+    int hi = lo + length;
+    int64_t sum = 0;
+    if constexpr (How == Scan::ForEach) {
+      tree.for_each_in_range(lo, hi, [&](int key) { sum += key; });
+    } else if constexpr (How == Scan::Iterator) {
+      for (auto it = tree.lower_bound(lo); it != tree.end() && *it < hi; ++it) {
+        sum += *it;
+      }
+    } else if constexpr (How == Scan::Set) {
+      for (auto it = set.lower_bound(lo); it != set.end() && *it < hi; ++it) {
+        sum += *it;
+      }
+    } else {
+      auto it = std::lower_bound(keys.begin(), keys.end(), lo);
+      for (; it != keys.end() && *it < hi; ++it) {
+        sum += *it;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * length);
+}
+
+#define RBTREE_SCANS \
+  RangeMultiplier(32)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond)
+
+BENCHMARK_TEMPLATE(rbtree_range_scan, Scan::ForEach)->RBTREE_SCANS;
+BENCHMARK_TEMPLATE(rbtree_range_scan, Scan::Iterator)->RBTREE_SCANS;
+BENCHMARK_TEMPLATE(rbtree_range_scan, Scan::Set)->RBTREE_SCANS;
+BENCHMARK_TEMPLATE(rbtree_range_scan, Scan::SortedVector)->RBTREE_SCANS;
+
+#undef RBTREE_SCANS
+
+// 64K distinct 32-byte strings, past the small-string buffer
+static std::vector<std::string> stringKeys() {
+  std::vector<std::string> keys(1 << 16);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = "key:" + std::to_string(i);
+    keys[i].resize(32, 'a');
+  }
+  return keys;
+}
+
+// moves random keys of the set to new keys: removes each and inserts a
+// changed copy, or extracts its node, changes the key in place and links
+// the node back
+enum class Rekey { RemoveInsert, Extract, SetExtract };
+
+template <Rekey How>
+static void rbtree_rekey(benchmark::State& state) {
+  auto keys = stringKeys();
+  rbtree::RBTree<std::string> tree;
+  std::set<std::string> set;
+  for (auto& key : keys) {
+    if constexpr (How == Rekey::SetExtract) {
+      set.insert(key);
+    } else {
+      tree.insert(key);
+    }
+  }
+  std::mt19937 gen(3);
+  for (auto _ : state) {
+    std::string& key = keys[gen() % keys.size()];
+    char next = key.back() == 'a' ? 'b' : 'a';
+    if constexpr (How == Rekey::RemoveInsert) {
+      std::string moved = key;
+      moved.back() = next;
+      tree.remove(key);
+      tree.insert(std::move(moved));
+    } else if constexpr (How == Rekey::Extract) {
+      auto node = tree.extract(key);
+      node.value().back() = next;
+      tree.insert(std::move(node));
+    } else {
+      auto node = set.extract(key);
+      node.value().back() = next;
+      set.insert(std::move(node));
+    }
+    key.back() = next;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(rbtree_rekey, Rekey::RemoveInsert);
+BENCHMARK_TEMPLATE(rbtree_rekey, Rekey::Extract);
+BENCHMARK_TEMPLATE(rbtree_rekey, Rekey::SetExtract);
+
+// finds string keys given as string_views. std::less<> compares them to
+// the keys as they are; std::less<std::string> needs a std::string built
+// for each lookup.
+template <bool Transparent>
+static void rbtree_find_string_view(benchmark::State& state) {
+  using Compare =
+    std::conditional_t<Transparent, std::less<>, std::less<std::string>>;
+  auto keys = stringKeys();
+  rbtree::RBTree<std::string, Compare> tree;
+  for (auto& key : keys) {
+    tree.insert(key);
+  }
+  std::vector<std::string_view> views(keys.begin(), keys.end());
+  std::shuffle(views.begin(), views.end(), std::mt19937(4));
+  for (auto _ : state) {
+    int64_t found = 0;
+    for (std::string_view view : views) {
+      if constexpr (Transparent) {
+        found += tree.find(view) != nullptr;
+      } else {
+        found += tree.find(std::string(view)) != nullptr;
+      }
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * views.size());
+}
+
+BENCHMARK_TEMPLATE(rbtree_find_string_view, false);
+BENCHMARK_TEMPLATE(rbtree_find_string_view, true);
+
+// merging two 1M-key trees whose keys overlap by half: the set operations
+// on range(0) threads, against inserting or removing other's keys one by
+// one. the trees are rebuilt, untimed, for every iteration.
+enum class Merge { Union, Inserts, Difference, Removes };
+
+template <Merge How>
+static void rbtree_merge(benchmark::State& state) {
+  constexpr int kMergeKeys = 1 << 20;
+  std::vector<int> mine(kMergeKeys);
+  std::vector<int> theirs(kMergeKeys);
+  for (int i = 0; i < kMergeKeys; ++i) {
+    mine[i] = 2 * i;               // 0, 2, .., 2M: the even keys
+    theirs[i] = kMergeKeys / 2 + i;  // 0.5M .. 1.5M, every other one mine
+  }
+  std::vector<int> probes = theirs;
+  std::shuffle(probes.begin(), probes.end(), std::mt19937(5));
+  const auto other = Arena::fromSorted(theirs);
+  auto threads = static_cast<unsigned>(state.range(0));
+  std::size_t changed = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    {
+      auto tree = Arena::fromSorted(mine);
+      state.ResumeTiming();
+      if constexpr (How == Merge::Union) {
+        changed = tree.unionWith(other, threads);
+      } else if constexpr (How == Merge::Difference) {
+        changed = tree.differenceWith(other, threads);
+      } else {
+        changed = 0;
+        for (int key : probes) {
+          changed +=
+            How == Merge::Inserts ? tree.insert(key) : tree.remove(key);
+        }
+      }
+      benchmark::DoNotOptimize(changed);
+      state.PauseTiming();  // the tree is freed untimed
+    }
+    state.ResumeTiming();
+  }
+  state.counters["changed"] = changed;
+  state.SetItemsProcessed(state.iterations() * kMergeKeys);
+}
+
+BENCHMARK_TEMPLATE(rbtree_merge, Merge::Union)
+  ->Arg(1)
+  ->Arg(4)
+  ->Arg(16)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+BENCHMARK_TEMPLATE(rbtree_merge, Merge::Inserts)
+  ->Arg(1)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+BENCHMARK_TEMPLATE(rbtree_merge, Merge::Difference)
+  ->Arg(1)
+  ->Arg(4)
+  ->Arg(16)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+BENCHMARK_TEMPLATE(rbtree_merge, Merge::Removes)
+  ->Arg(1)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+// 64K random finds, half of them misses, in a tree of range(0) keys: a
+// find at a time, or findBatch. the large tree (512 MB of nodes) is well
+// past the last level cache, so most levels of a find are a DRAM miss.
+template <bool Batch>
+static void rbtree_find_batch(benchmark::State& state) {
+  auto size = static_cast<int>(state.range(0));
+  std::vector<int> keys(size);
+  std::iota(keys.begin(), keys.end(), 0);
+  for (int& key : keys) {
+    key *= 2;
+  }
+  const auto tree = Arena::fromSorted(keys);
+  std::vector<int> probes(1 << 16);
+  std::mt19937 gen(6);
+  for (int& probe : probes) {
+    probe = static_cast<int>(gen() % (2 * size));
+  }
+  std::vector<const int*> out(probes.size());
+  for (auto _ : state) {
+    std::size_t found = 0;
+    if constexpr (Batch) {
+      found = tree.findBatch(probes, out);
+    } else {
+      for (std::size_t i = 0; i < probes.size(); ++i) {
+        out[i] = tree.find(probes[i]);
+        found += out[i] != nullptr;
+      }
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+
+BENCHMARK_TEMPLATE(rbtree_find_batch, false)->Arg(1 << 16)->Arg(1 << 25);
+BENCHMARK_TEMPLATE(rbtree_find_batch, true)->Arg(1 << 16)->Arg(1 << 25);
+
+// a tree of 64K keys shared by every thread of a run, filled once
+template <rbtree::ReadMode Mode>
+static rbtree::RBTree<int, std::less<int>, Mode>& sharedTree() {
+  static rbtree::RBTree<int, std::less<int>, Mode> tree;
+  static bool filled = [] {
+    for (int key : shuffledKeys(1 << 16)) {
+      tree.insert(key * 2);
+    }
+    return true;
+  }();
+  (void)filled;
+  return tree;
+}
+
+// every thread does range(0)% writes (an insert or remove of a random key)
+// and the rest finds. writers are serialized either way; the question is
+// whether readers are serialized with them and with each other.
+template <rbtree::ReadMode Mode>
+static void rbtree_read_mostly(benchmark::State& state) {
+  auto& tree = sharedTree<Mode>();
+  std::mt19937 gen(state.thread_index());
+  std::uniform_int_distribution<int> key(0, (1 << 17) - 1);
+  std::uniform_int_distribution<int> percent(0, 99);
+  int64_t found = 0;
+  for (auto _ : state) {
+    int k = key(gen);
+    if (percent(gen) < state.range(0)) {
+      if (!tree.insert(k)) {
+        tree.remove(k);
+      }
+    } else {
+      found += static_cast<bool>(tree.find(k));
+    }
+  }
+  benchmark::DoNotOptimize(found);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(rbtree_read_mostly, rbtree::ReadMode::Locked)
+  ->Arg(1)
+  ->Arg(10)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+BENCHMARK_TEMPLATE(rbtree_read_mostly, rbtree::ReadMode::Optimistic)
+  ->Arg(1)
+  ->Arg(10)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+
+#define RBTREE_SIZES                 \
+  Arg(1'000'000)                     \
+    ->Arg(10'000'000)                \
+    ->Unit(benchmark::kMillisecond) \
+    ->Iterations(1)
+
+BENCHMARK_TEMPLATE(rbtree_insert, Arena)->RBTREE_SIZES;
+BENCHMARK_TEMPLATE(rbtree_insert, Shared)->RBTREE_SIZES;
+BENCHMARK_TEMPLATE(rbtree_insert, Set)->RBTREE_SIZES;
+BENCHMARK_TEMPLATE(rbtree_find, Arena)->RBTREE_SIZES;
+BENCHMARK_TEMPLATE(rbtree_find, Shared)->RBTREE_SIZES;
+BENCHMARK_TEMPLATE(rbtree_find, Set)->RBTREE_SIZES;
+
+BENCHMARK(rbtree_build_inserts)->RBTREE_SIZES;
+BENCHMARK(rbtree_build_sorted)->RBTREE_SIZES;
+
+#undef RBTREE_SIZES
+
+#define RBTREE_BATCHES                         \
+  Args({1'000'000, 10'000})                    \
+    ->Args({1'000'000, 1'000'000})             \
+    ->Unit(benchmark::kMillisecond)            \
+    ->Iterations(3)
+
+BENCHMARK_TEMPLATE(rbtree_insert_batch, false)->RBTREE_BATCHES;
+BENCHMARK_TEMPLATE(rbtree_insert_batch, true)->RBTREE_BATCHES;
+
+#undef RBTREE_BATCHES
+
+}  // namespace bc
+}  // namespace lz
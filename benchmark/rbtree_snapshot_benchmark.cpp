@@ -0,0 +1,189 @@
+/*
+ * @Description: restarting with a 10M-key RBTree: rebuild it, or map a
+ * saved snapshot
+ * @Author: lize
+ * @Date: 2025-11-10
+ * @LastEditors: lize
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "benchmark/benchmark.h"
+#include "utils/rbtree.h"
+#include "utils/rbtree_snapshot.h"
+
+namespace lz {
+namespace bc {
+constexpr int kSnapshotKeys = 10'000'000;
+constexpr int kFirstQueries = 1000;
+
+static std::vector<int> snapshotKeys() {
+  std::vector<int> keys(kSnapshotKeys);
+  std::iota(keys.begin(), keys.end(), 0);
+  for (int& key : keys) {
+    key *= 2;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+  return keys;
+}
+
+// the even keys saved once per layout, removed at exit
+static const std::filesystem::path& snapshotFile(
+  rbtree::SnapshotLayout layout) {
+  struct Files {
+    std::filesystem::path paths[2];
+    Files() {
+      auto keys = snapshotKeys();
+      std::sort(keys.begin(), keys.end());
+      for (auto layout : {rbtree::SnapshotLayout::Sorted,
+                          rbtree::SnapshotLayout::Eytzinger}) {
+        auto& path = paths[static_cast<int>(layout)];
+        path = std::filesystem::temp_directory_path() /
+               ("lz_rbtree_bench_" +
+                std::to_string(static_cast<int>(layout)) + ".snap");
+        rbtree::saveSnapshot(std::span<const int>(keys), path, layout);
+      }
+    }
+    ~Files() {
+      for (auto& path : paths) {
+        std::filesystem::remove(path);
+      }
+    }
+  };
+  static Files files;
+  return files.paths[static_cast<int>(layout)];
+}
+
+// drops the file from the page cache, so the next read goes to the disk
+static void evict(const std::filesystem::path& path) {
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+#endif
+}
+
+// from nothing to the answers of kFirstQueries finds, with the snapshot
+// file out of the page cache:
+//   Inserts: inserting the keys one by one, as a restart does today, from
+//     keys already in memory
+//   ReadAndBuild: reading a Sorted file whole, then the O(n) build
+//   MapSorted, MapEytzinger: mapping the file and searching it in place
+//   MapAndPromote: mapping a Sorted file and building a mutable tree
+enum class Start { Inserts, ReadAndBuild, MapSorted, MapEytzinger, Promote };
+
+template <Start How>
+static void snapshot_cold_start(benchmark::State& state) {
+  auto keys = snapshotKeys();
+  std::vector<int> probes(keys.begin(), keys.begin() + kFirstQueries);
+  auto layout = How == Start::MapEytzinger ? rbtree::SnapshotLayout::Eytzinger
+                                           : rbtree::SnapshotLayout::Sorted;
+  const auto& path = snapshotFile(layout);
+  for (auto _ : state) {
+    state.PauseTiming();
+    evict(path);
+    state.ResumeTiming();
+    int64_t found = 0;
+    if constexpr (How == Start::Inserts) {
+      rbtree::RBTree<int> tree;
+      for (int key : keys) {
+        tree.insert(key);
+      }
+      for (int key : probes) {
+        found += tree.find(key) != nullptr;
+      }
+    } else if constexpr (How == Start::ReadAndBuild) {
+      std::ifstream in(path, std::ios::binary);
+      std::vector<int> sorted(kSnapshotKeys);
+      in.seekg(rbtree::detail::SnapshotHeader::kValuesOffset);
+      in.read(reinterpret_cast<char*>(sorted.data()),
+              sorted.size() * sizeof(int));
+      auto tree = rbtree::RBTree<int>::fromSorted(sorted);
+      for (int key : probes) {
+        found += tree.find(key) != nullptr;
+      }
+    } else if constexpr (How == Start::Promote) {
+      auto tree = rbtree::MappedSnapshot<int>(path).toTree();
+      for (int key : probes) {
+        found += tree.find(key) != nullptr;
+      }
+    } else {
+      rbtree::MappedSnapshot<int> snapshot(path);
+      for (int key : probes) {
+        found += snapshot.find(key) != nullptr;
+      }
+    }
+    if (found != kFirstQueries) {
+      state.SkipWithError("lost keys");
+    }
+  }
+}
+
+BENCHMARK_TEMPLATE(snapshot_cold_start, Start::Inserts)
+  ->Unit(benchmark::kMillisecond)
+  ->Iterations(1);
+BENCHMARK_TEMPLATE(snapshot_cold_start, Start::ReadAndBuild)
+  ->Unit(benchmark::kMillisecond)
+  ->Iterations(3);
+BENCHMARK_TEMPLATE(snapshot_cold_start, Start::Promote)
+  ->Unit(benchmark::kMillisecond)
+  ->Iterations(3);
+BENCHMARK_TEMPLATE(snapshot_cold_start, Start::MapSorted)
+  ->Unit(benchmark::kMillisecond)
+  ->Iterations(10);
+BENCHMARK_TEMPLATE(snapshot_cold_start, Start::MapEytzinger)
+  ->Unit(benchmark::kMillisecond)
+  ->Iterations(10);
+
+// random finds once everything is in memory: the two mapped layouts
+// against the tree they were saved from
+template <typename Searcher>
+static void findAll(benchmark::State& state, const Searcher& searcher) {
+  auto probes = snapshotKeys();
+  probes.resize(1 << 20);
+  for (int& key : probes) {
+    key += key % 3 == 0;  // a third of them odd, so missing
+  }
+  for (auto _ : state) {
+    int64_t found = 0;
+    for (int key : probes) {
+      found += searcher.find(key) != nullptr;
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+
+static void snapshot_find_tree(benchmark::State& state) {
+  auto keys = snapshotKeys();
+  std::sort(keys.begin(), keys.end());
+  auto tree = rbtree::RBTree<int>::fromSorted(keys);
+  findAll(state, tree);
+}
+template <rbtree::SnapshotLayout Layout>
+static void snapshot_find_mapped(benchmark::State& state) {
+  rbtree::MappedSnapshot<int> snapshot(snapshotFile(Layout));
+  findAll(state, snapshot);
+}
+
+BENCHMARK(snapshot_find_tree)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(snapshot_find_mapped, rbtree::SnapshotLayout::Sorted)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(snapshot_find_mapped, rbtree::SnapshotLayout::Eytzinger)
+  ->Unit(benchmark::kMillisecond);
+
+}  // namespace bc
+}  // namespace lz
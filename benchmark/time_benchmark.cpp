@@ -0,0 +1,144 @@
+/*
+ * @Description: the cost of reading the time: TscClock vs the clocks and
+ * helpers it replaces; and of parsing and formatting "HH:MM:SS uuuuuu"
+ * @Author: lize
+ * @Date: 2025-11-14
+ * @LastEditors: lize
+ */
+
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "utils/time.h"
+
+namespace lz {
+namespace bc {
+
+static void time_tsc_clock_now(benchmark::State& state) {
+  TscClock::calibrate();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(TscClock::now());
+  }
+}
+static void time_system_clock_now(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(getTimeStampNs());
+  }
+}
+static void time_steady_clock_now(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(std::chrono::steady_clock::now());
+  }
+}
+
+// a span of ticks to ns: the multiply-shift vs a float divide by the
+// frequency, which also has to be read from /proc/cpuinfo once
+static void time_ticks_to_ns_tsc_clock(benchmark::State& state) {
+  TscClock::calibrate();
+  uint64_t ticks = rdtsc();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(TscClock::toNs(++ticks));
+  }
+}
+static void time_ticks_to_ns_frequency(benchmark::State& state) {
+  float frequencyGHz = getFrequencyGHz();
+  uint64_t ticks = rdtsc();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(rdtsc2nanoTime(++ticks, frequencyGHz));
+  }
+}
+static void time_get_frequency(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(getFrequencyGHz());
+  }
+}
+
+BENCHMARK(time_tsc_clock_now);
+BENCHMARK(time_system_clock_now);
+BENCHMARK(time_steady_clock_now);
+BENCHMARK(time_ticks_to_ns_tsc_clock);
+BENCHMARK(time_ticks_to_ns_frequency);
+BENCHMARK(time_get_frequency);
+
+constexpr std::size_t kTimeRecords = 1 << 20;
+
+// kTimeRecords random "HH:MM:SS uuuuuu\n" lines
+static const std::string& timeLines() {
+  static const std::string lines = [] {
+    std::string lines(kTimeRecords * 16, '\n');
+    std::mt19937_64 gen(25);
+    std::uniform_int_distribution<uint64_t> micros(0, 86'400'000'000 - 1);
+    for (std::size_t i = 0; i < kTimeRecords; ++i) {
+      formatTimeNs(micros(gen) * 1000, &lines[i * 16]);
+    }
+    return lines;
+  }();
+  return lines;
+}
+
+// timeToNanoseconds as it was: a stringstream for every string
+static uint64_t streamTimeNs(const std::string& timeStr) {
+  int hours, minutes, seconds, microseconds;
+  char colon;
+  std::stringstream ss(timeStr);
+  ss >> hours >> colon >> minutes >> colon >> seconds >> microseconds;
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(hours * 1h + minutes * 1min +
+                                    seconds * 1s + microseconds * 1us)
+    .count();
+}
+
+enum class Parse { Stream, OneByOne, Batch };
+
+template <Parse How>
+static void time_parse(benchmark::State& state) {
+  const std::string& lines = timeLines();
+  std::vector<std::string> strings;
+  if constexpr (How == Parse::Stream) {
+    for (std::size_t i = 0; i < kTimeRecords; ++i) {
+      strings.push_back(lines.substr(i * 16, kTimeLength));
+    }
+  }
+  std::vector<uint64_t> out(kTimeRecords);
+  for (auto _ : state) {
+    if constexpr (How == Parse::Stream) {
+      for (std::size_t i = 0; i < kTimeRecords; ++i) {
+        out[i] = streamTimeNs(strings[i]);
+      }
+    } else if constexpr (How == Parse::OneByOne) {
+      std::string_view view(lines);
+      for (std::size_t i = 0; i < kTimeRecords; ++i) {
+        out[i] = parseTimeNs(view.substr(i * 16, kTimeLength)).value_or(0);
+      }
+    } else {
+      benchmark::DoNotOptimize(parseTimesNs(lines, 16, out));
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * kTimeRecords);
+}
+
+static void time_format(benchmark::State& state) {
+  std::vector<uint64_t> times(kTimeRecords);
+  parseTimesNs(timeLines(), 16, times);
+  std::string lines(kTimeRecords * 16, '\n');
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < kTimeRecords; ++i) {
+      formatTimeNs(times[i], &lines[i * 16]);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * kTimeRecords);
+}
+
+BENCHMARK_TEMPLATE(time_parse, Parse::Stream)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(time_parse, Parse::OneByOne)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(time_parse, Parse::Batch)->Unit(benchmark::kMillisecond);
+BENCHMARK(time_format)->Unit(benchmark::kMillisecond);
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,57 @@
+/*
+ * @Description: what a LZ_TRACE_SCOPE probe adds to the code around it
+ * @Author: lize
+ * @Date: 2025-11-17
+ * @LastEditors: lize
+ */
+
+#ifndef LZ_TRACE
+#define LZ_TRACE
+#endif
+#include <filesystem>
+
+#include "benchmark/benchmark.h"
+#include "utils/trace.h"
+
+namespace lz {
+namespace bc {
+
+// the two rdtscp a probe cannot do without
+static void trace_rdtscp_pair(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(rdtscp());
+    benchmark::DoNotOptimize(rdtscp());
+  }
+}
+
+// a probe around nothing, with a collector draining the rings meanwhile
+static void trace_probe(benchmark::State& state) {
+  auto prefix = std::filesystem::temp_directory_path() / "lz_trace_benchmark";
+  {
+    trace::Collector collector(prefix, std::chrono::milliseconds(10));
+    for (auto _ : state) {
+      LZ_TRACE_SCOPE("bench.empty");
+      benchmark::ClobberMemory();
+    }
+    state.counters["recorded"] =
+      static_cast<double>(collector.histogram("bench.empty").count());
+  }
+  std::filesystem::remove(prefix.string() + ".txt");
+  std::filesystem::remove(prefix.string() + ".folded");
+}
+
+// a full ring: what a probe costs when the collector falls behind
+static void trace_probe_dropping(benchmark::State& state) {
+  trace::Probe probe("bench.dropping");
+  for (auto _ : state) {
+    trace::Scope scope(probe);
+    benchmark::ClobberMemory();
+  }
+}
+
+BENCHMARK(trace_rdtscp_pair);
+BENCHMARK(trace_probe);
+BENCHMARK(trace_probe_dropping);
+
+}  // namespace bc
+}  // namespace lz
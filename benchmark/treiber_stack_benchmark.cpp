@@ -0,0 +1,69 @@
+/*
+ * @Description: Treiber stack vs mutex-guarded std::stack under contention
+ * @Author: lize
+ * @Date: 2025-10-27
+ * @LastEditors: lize
+ */
+
+#include <mutex>
+#include <optional>
+#include <stack>
+
+#include "benchmark/benchmark.h"
+#include "treiber_stack.h"
+
+namespace lz {
+namespace bc {
+
+template <typename T>
+class LockedStack {
+ public:
+  void push(T value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stack.push(std::move(value));
+  }
+  std::optional<T> pop() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stack.empty()) {
+      return std::nullopt;
+    }
+    T value = std::move(_stack.top());
+    _stack.pop();
+    return value;
+  }
+
+ private:
+  std::mutex _mutex;
+  std::stack<T> _stack;
+};
+
+// every thread pushes a batch and pops it back, so the stack stays shallow
+// and all threads fight over the head.
+template <typename Stack>
+static void stack_push_pop(benchmark::State& state) {
+  static Stack stack;
+  const int batch = state.range(0);
+  int64_t popped = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < batch; ++i) {
+      stack.push(i);
+    }
+    for (int i = 0; i < batch; ++i) {
+      popped += stack.pop().has_value();
+    }
+  }
+  benchmark::DoNotOptimize(popped);
+  state.SetItemsProcessed(state.iterations() * batch * 2);
+}
+
+BENCHMARK_TEMPLATE(stack_push_pop, Taggedpointer::TreiberStack<int>)
+  ->Arg(16)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+BENCHMARK_TEMPLATE(stack_push_pop, LockedStack<int>)
+  ->Arg(16)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+
+}  // namespace bc
+}  // namespace lz
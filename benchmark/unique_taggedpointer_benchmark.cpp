@@ -0,0 +1,82 @@
+/*
+ * @Description: pooled UniqueTaggedPointer vs unique_ptr<Base> churn
+ * @Author: lize
+ * @Date: 2025-10-28
+ * @LastEditors: lize
+ */
+
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "unique_taggedpointer.h"
+
+namespace lz {
+namespace bc {
+
+struct Base {
+  virtual ~Base() = default;
+  virtual int64_t Get() const = 0;
+};
+struct VirtualSmall : Base {
+  int64_t Get() const override {
+    return value;
+  }
+  int64_t value = 1;
+};
+struct VirtualLarge : Base {
+  int64_t Get() const override {
+    return values[0];
+  }
+  int64_t values[8] = {2};
+};
+
+struct Small {
+  int64_t value = 1;
+};
+struct Large {
+  int64_t values[8] = {2};
+};
+using Owned = Taggedpointer::UniqueTaggedPointer<
+  Taggedpointer::TaggedPointer<Small, Large>>;
+
+// create a batch of mixed objects then destroy them all, over and over
+static void churn_unique_ptr_virtual(benchmark::State& state) {
+  std::vector<std::unique_ptr<Base>> objects;
+  objects.reserve(state.range(0));
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      if (i & 1) {
+        objects.push_back(std::make_unique<VirtualLarge>());
+      } else {
+        objects.push_back(std::make_unique<VirtualSmall>());
+      }
+    }
+    benchmark::DoNotOptimize(objects.data());
+    objects.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void churn_unique_tagged_pool(benchmark::State& state) {
+  std::vector<Owned> objects;
+  objects.reserve(state.range(0));
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      if (i & 1) {
+        objects.push_back(Owned::Make<Large>());
+      } else {
+        objects.push_back(Owned::Make<Small>());
+      }
+    }
+    benchmark::DoNotOptimize(objects.data());
+    objects.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(churn_unique_ptr_virtual)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK(churn_unique_tagged_pool)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,168 @@
+/*
+ * @Description: Visit and pairwise Visit vs std::visit on std::variant
+ * @Author: lize
+ * @Date: 2025-11-02
+ * @LastEditors: lize
+ */
+
+#include <random>
+#include <variant>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "taggedpointer.h"
+
+namespace lz {
+namespace bc {
+
+struct Circle {
+  double r = 1.0;
+};
+struct Square {
+  double side = 2.0;
+};
+struct Triangle {
+  double base = 3.0;
+  double height = 1.0;
+};
+struct Segment {
+  int length = 4;
+};
+
+using Shape = Taggedpointer::TaggedPointer<Circle, Square, Triangle, Segment>;
+using ShapeVariant = std::variant<Circle*, Square*, Triangle*, Segment*>;
+
+// the alternatives return different types; Visit converts to double
+struct Area {
+  double operator()(Circle* c) const {
+    return 3.0 * c->r * c->r;
+  }
+  double operator()(Square* s) const {
+    return s->side * s->side;
+  }
+  float operator()(Triangle* t) const {
+    return static_cast<float>(t->base * t->height / 2);
+  }
+  int operator()(Segment*) const {
+    return 0;
+  }
+};
+
+// a symmetric cost table in place of real collision code
+struct Collide {
+  template <typename A, typename B>
+  double operator()(A* a, B* b) const {
+    return Area{}(a) + 2 * Area{}(b);
+  }
+};
+
+class Shapes {
+ public:
+  explicit Shapes(std::size_t count) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 3);
+    for (std::size_t i = 0; i < count; ++i) {
+      switch (dist(gen)) {
+        case 0:
+          add(&_circle);
+          break;
+        case 1:
+          add(&_square);
+          break;
+        case 2:
+          add(&_triangle);
+          break;
+        default:
+          add(&_segment);
+      }
+    }
+  }
+  std::vector<Shape> handles;
+  std::vector<ShapeVariant> variants;
+
+ private:
+  template <typename T>
+  void add(T* shape) {
+    handles.push_back(shape);
+    variants.push_back(shape);
+  }
+
+  Circle _circle;
+  Square _square;
+  Triangle _triangle;
+  Segment _segment;
+};
+
+// the result leaves through a captured reference, as before Visit existed
+static void visit_dispatch_capture(benchmark::State& state) {
+  Shapes shapes(state.range(0));
+  for (auto _ : state) {
+    double sum = 0;
+    for (auto& handle : shapes.handles) {
+      handle.Dispatch([&sum](auto ptr) { sum += Area{}(ptr); });
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void visit_tagged(benchmark::State& state) {
+  Shapes shapes(state.range(0));
+  for (auto _ : state) {
+    double sum = 0;
+    for (auto& handle : shapes.handles) {
+      sum += handle.Visit(Area{});
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void visit_variant(benchmark::State& state) {
+  Shapes shapes(state.range(0));
+  for (auto _ : state) {
+    double sum = 0;
+    for (auto& variant : shapes.variants) {
+      sum += std::visit([](auto ptr) -> double { return Area{}(ptr); },
+                        variant);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// every neighbouring pair: 16 combinations in random order
+static void visit_pair_tagged(benchmark::State& state) {
+  Shapes shapes(state.range(0) + 1);
+  auto& handles = shapes.handles;
+  for (auto _ : state) {
+    double sum = 0;
+    for (std::size_t i = 0; i + 1 < handles.size(); ++i) {
+      sum += Taggedpointer::Visit(Collide{}, handles[i], handles[i + 1]);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void visit_pair_variant(benchmark::State& state) {
+  Shapes shapes(state.range(0) + 1);
+  auto& variants = shapes.variants;
+  for (auto _ : state) {
+    double sum = 0;
+    for (std::size_t i = 0; i + 1 < variants.size(); ++i) {
+      sum += std::visit(Collide{}, variants[i], variants[i + 1]);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(visit_dispatch_capture)->Arg(1 << 12);
+BENCHMARK(visit_tagged)->Arg(1 << 12);
+BENCHMARK(visit_variant)->Arg(1 << 12);
+BENCHMARK(visit_pair_tagged)->Arg(1 << 12)->Arg(1 << 20);
+BENCHMARK(visit_pair_variant)->Arg(1 << 12)->Arg(1 << 20);
+
+}  // namespace bc
+}  // namespace lz
@@ -0,0 +1,108 @@
+/*
+ * @Description: atomic TaggedPointer with an ABA generation counter
+ * @Author: lize
+ * @Date: 2025-10-27
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "taggedpointer.h"
+
+namespace Taggedpointer {
+
+// a TaggedPointer<Ts...> in one std::atomic<uint64_t>. the spare high bits
+// left over by the tag and any Payload hold a generation counter that every
+// successful compare_exchange bumps, so a CAS against a stale value fails
+// even if the same address has come back (ABA), without a 16-byte DWCAS.
+// the counter wraps after 2^kGenerationBits updates.
+template <typename... Ts>
+class AtomicTaggedPointer {
+ public:
+  using Pointer = TaggedPointer<Ts...>;
+  using Layout = typename Pointer::Layout;
+  static constexpr int kGenerationBits = Layout::kSpareBits;
+  static_assert(kGenerationBits > 0, "no spare bits left for a generation");
+
+  AtomicTaggedPointer() = default;
+  explicit AtomicTaggedPointer(Pointer ptr) : _bits(ptr.Raw()) {
+  }
+  AtomicTaggedPointer(const AtomicTaggedPointer&) = delete;
+  AtomicTaggedPointer& operator=(const AtomicTaggedPointer&) = delete;
+
+  Pointer load(std::memory_order order = std::memory_order_seq_cst) const {
+    return Pointer::FromRaw(_bits.load(order));
+  }
+
+  // stores desired as is, generation included.
+  void store(Pointer desired,
+             std::memory_order order = std::memory_order_seq_cst) {
+    _bits.store(desired.Raw(), order);
+  }
+
+  // on success the stored value is desired with the generation of expected
+  // plus one; on failure expected is refreshed with the current value.
+  bool compare_exchange_weak(Pointer& expected,
+                             Pointer desired,
+                             std::memory_order success,
+                             std::memory_order failure) {
+    uint64_t old = expected.Raw();
+    bool done =
+      _bits.compare_exchange_weak(old, next(old, desired), success, failure);
+    expected = Pointer::FromRaw(old);
+    return done;
+  }
+  bool compare_exchange_weak(
+    Pointer& expected,
+    Pointer desired,
+    std::memory_order order = std::memory_order_seq_cst) {
+    return compare_exchange_weak(expected, desired, order, failureOrder(order));
+  }
+
+  bool compare_exchange_strong(Pointer& expected,
+                               Pointer desired,
+                               std::memory_order success,
+                               std::memory_order failure) {
+    uint64_t old = expected.Raw();
+    bool done =
+      _bits.compare_exchange_strong(old, next(old, desired), success, failure);
+    expected = Pointer::FromRaw(old);
+    return done;
+  }
+  bool compare_exchange_strong(
+    Pointer& expected,
+    Pointer desired,
+    std::memory_order order = std::memory_order_seq_cst) {
+    return compare_exchange_strong(
+      expected, desired, order, failureOrder(order));
+  }
+
+  static uint64_t Generation(Pointer ptr) {
+    return Layout::Spare(ptr.Raw());
+  }
+
+  bool is_lock_free() const {
+    return _bits.is_lock_free();
+  }
+
+ private:
+  static uint64_t next(uint64_t expected, Pointer desired) {
+    return Layout::WithSpare(desired.Raw(), Layout::Spare(expected) + 1);
+  }
+  // same rule std::atomic uses for the single-order overloads
+  static constexpr std::memory_order failureOrder(std::memory_order order) {
+    if (order == std::memory_order_acq_rel) {
+      return std::memory_order_acquire;
+    }
+    if (order == std::memory_order_release) {
+      return std::memory_order_relaxed;
+    }
+    return order;
+  }
+
+  std::atomic<uint64_t> _bits{0};
+};
+
+}  // namespace Taggedpointer
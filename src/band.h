@@ -8,7 +8,9 @@
 
 #include <fmt/core.h>
 
+#include "slab_pool.h"
 #include "taggedpointer.h"
+#include "unique_taggedpointer.h"
 
 namespace Taggedpointer {
 
@@ -18,20 +20,15 @@ class Mujica;
 class Band : public TaggedPointer<Mygo, Mujica> {
  public:
   using TaggedPointer::TaggedPointer;
-  void Vocal() {
-    auto func = [](auto ptr) { ptr->Vocal(); };
-    Dispatch(func);
-  }
+  void Vocal();
 };
 
 class Mygo {
  public:
+  // pooled; own the result with UniqueBand
   static Mygo* Create() {
-    return new Mygo();
+    return SlabPool<Mygo>::New();
   }
-  // static void Destroy() {
-  //   ~Mygo();
-  // }
   void Vocal() {
     fmt::print("gugu gaga\n");
   };
@@ -40,11 +37,20 @@ class Mygo {
 class Mujica {
  public:
   static Mujica* Create() {
-    return new Mujica();
+    return SlabPool<Mujica>::New();
   }
   void Vocal() {
     fmt::print("saki saki saki\n");
   };
 };
 
+// defined after the concrete bands: Dispatch deduces the visitor's return
+// type, which needs complete types.
+inline void Band::Vocal() {
+  auto func = [](auto ptr) { ptr->Vocal(); };
+  Dispatch(func);
+}
+
+using UniqueBand = UniqueTaggedPointer<Band>;
+
 }  // namespace Taggedpointer
\ No newline at end of file
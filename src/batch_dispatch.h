@@ -0,0 +1,104 @@
+/*
+ * @Description: dispatch a whole container of tagged handles, grouped by type
+ * @Author: lize
+ * @Date: 2025-10-29
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "taggedpointer.h"
+
+namespace Taggedpointer {
+
+enum class BatchOrder : uint8_t {
+  // reorder the handles in place so they are grouped by type. later passes
+  // over the same container then find it already grouped.
+  Partition,
+  // leave the container as it is and group a scratch copy.
+  Keep,
+};
+
+namespace detail {
+template <typename Handle, typename Func, std::size_t... Is>
+void dispatchBuckets(const Handle* grouped,
+                     const std::size_t* offsets,
+                     Func& func,
+                     std::index_sequence<Is...>) {
+  // one monomorphic loop per type: the call target is fixed inside a loop,
+  // so there is no data-dependent branch left per element.
+  auto loop = [&]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+    for (auto i = offsets[I]; i < offsets[I + 1]; ++i) {
+      func(Handle::template Decode<I>(grouped[i].Raw()));
+    }
+  };
+  (loop(std::integral_constant<std::size_t, Is>{}), ...);
+}
+}  // namespace detail
+
+// calls func once per handle, all handles of type 0 first, then type 1 and
+// so on; within a type the original order is kept. a counting pass sizes
+// the buckets and a stable scatter fills them, so the cost is two linear
+// passes instead of one unpredictable branch per element.
+template <std::ranges::contiguous_range Range, typename Func>
+void DispatchAll(Range&& handles,
+                 Func&& func,
+                 BatchOrder order = BatchOrder::Partition) {
+  using Handle = std::remove_cv_t<std::ranges::range_value_t<Range>>;
+  constexpr std::size_t kTypes = Handle::kTypeCount;
+  constexpr bool kMutable = !std::is_const_v<
+    std::remove_reference_t<std::ranges::range_reference_t<Range>>>;
+
+  const Handle* first = std::ranges::data(handles);
+  std::size_t size = std::ranges::size(handles);
+
+  std::array<std::size_t, kTypes + 1> offsets{};
+  std::size_t last = 0;
+  bool grouped = true;
+  for (std::size_t i = 0; i < size; ++i) {
+    auto index = first[i].Index();
+    grouped &= index >= last;
+    last = index;
+    ++offsets[index + 1];
+  }
+  for (std::size_t t = 0; t < kTypes; ++t) {
+    offsets[t + 1] += offsets[t];
+  }
+  // already in type order, e.g. partitioned by an earlier call
+  if (grouped) {
+    detail::dispatchBuckets(
+      first, offsets.data(), func, std::make_index_sequence<kTypes>{});
+    return;
+  }
+
+  // the buffer is cached per thread and taken out for the call, so func may
+  // itself call DispatchAll.
+  thread_local std::vector<Handle> cache;
+  std::vector<Handle> scratch = std::move(cache);
+  scratch.resize(size);
+  auto cursor = offsets;
+  for (std::size_t i = 0; i < size; ++i) {
+    scratch[cursor[first[i].Index()]++] = first[i];
+  }
+
+  detail::dispatchBuckets(scratch.data(),
+                          offsets.data(),
+                          func,
+                          std::make_index_sequence<kTypes>{});
+
+  if constexpr (kMutable) {
+    if (order == BatchOrder::Partition) {
+      std::copy(scratch.begin(), scratch.end(), std::ranges::begin(handles));
+    }
+  }
+  cache = std::move(scratch);
+}
+
+}  // namespace Taggedpointer
@@ -13,13 +13,12 @@ using namespace Taggedpointer;
 int main() {
   fmt::print("Hello, World!\n");
 
-  Band mygo = Mygo::Create();
-  mygo.Vocal();
+  UniqueBand mygo{Mygo::Create()};
+  mygo->Vocal();
 
-  Band mujica = Mujica::Create();
-  mujica.Vocal();
+  UniqueBand mujica{Mujica::Create()};
+  mujica->Vocal();
 
-  // TODO 如何清理？
-  // mygo.Delete();
+  // UniqueBand hands both back to their pools on scope exit
   return 0;
 }
\ No newline at end of file
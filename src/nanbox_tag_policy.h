@@ -0,0 +1,80 @@
+/*
+ * @Description: NaN-boxing tag policy for inline doubles beside pointers
+ * @Author: lize
+ * @Date: 2025-11-01
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+#include "slab_pool.h"
+#include "taggedpointer.h"
+
+namespace Taggedpointer {
+
+// the top 16 bits are the type index for everything but the double, whose
+// bits are stored offset by kTypes << 48 (the JavaScriptCore scheme). every
+// finite double, the infinities and the one canonical NaN land above the
+// tags, so the double itself needs no tag bits and keeps all 64:
+//
+//   [ index:16 ][ address or Inline<T> value:48 ]   index < kTypes
+//   [        double bits + (kTypes << 48)       ]   top 16 >= kTypes
+//
+// NaNs are canonicalized on the way in; their payload and sign are lost.
+// no spare bits are left, so no Payload or AtomicTaggedPointer.
+template <typename... Ts>
+struct NanBoxLayout {
+  static constexpr std::size_t kTypes = sizeof...(Ts);
+  static_assert(kTypes > 0, "TaggedPointer needs at least one type");
+  // -inf has the largest top 16 bits of any boxed double, 0xFFF0
+  static_assert(kTypes <= 15, "NanBoxTagPolicy takes at most 15 types");
+
+  static constexpr int64_t kDoubleIndex = IndexOf<Inline<double>, Ts...>();
+  static constexpr uint64_t kPointerMask = (uint64_t{1} << 48) - 1;
+  static constexpr uint64_t kDoubleOffset = uint64_t{kTypes} << 48;
+  static constexpr int kSpareBits = 0;
+
+  static uint64_t Encode(std::size_t index, const void* ptr) {
+    auto bits = reinterpret_cast<uint64_t>(ptr);
+    assert((bits & ~kPointerMask) == 0);
+    assert(static_cast<int64_t>(index) != kDoubleIndex);
+    return static_cast<uint64_t>(index) << 48 | bits;
+  }
+  static std::size_t Index(uint64_t bits) {
+    std::size_t top = bits >> 48;
+    if constexpr (kDoubleIndex >= 0) {
+      return top < kTypes ? top : kDoubleIndex;
+    } else {
+      return top;
+    }
+  }
+  static uint64_t Pointer(uint64_t bits) {
+    return bits & kPointerMask;
+  }
+
+  static uint64_t BoxDouble(double value) {
+    if (value != value) {
+      value = std::numeric_limits<double>::quiet_NaN();
+    }
+    return std::bit_cast<uint64_t>(value) + kDoubleOffset;
+  }
+  static double UnboxDouble(uint64_t bits) {
+    return std::bit_cast<double>(bits - kDoubleOffset);
+  }
+};
+
+// TaggedPointer<NanBoxTagPolicy, Inline<double>, Inline<int64_t>, Node>
+struct NanBoxTagPolicy {
+  template <typename... Ts>
+  using Layout = NanBoxLayout<Ts...>;
+  template <typename T, typename Types>
+  using Pool = SlabPool<T>;
+};
+template <>
+struct IsTagPolicy<NanBoxTagPolicy> : std::true_type {};
+
+}  // namespace Taggedpointer
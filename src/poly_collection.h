@@ -0,0 +1,208 @@
+/*
+ * @Description: per-type contiguous storage addressed by tagged handles
+ * @Author: lize
+ * @Date: 2025-10-30
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "taggedpointer.h"
+
+namespace Taggedpointer {
+
+// a stable reference into a PolyCollection, 8 bytes like a TaggedPointer:
+//   [ type index:16 | generation:16 | slot:32 ]
+// the slot goes through the collection's indirection table, so the handle
+// survives other elements being erased and moved. the generation makes a
+// handle to an erased element stop resolving once its slot is reused.
+class PolyHandle {
+ public:
+  PolyHandle() = default;
+  PolyHandle(std::size_t index, uint32_t generation, uint32_t slot)
+    : _bits(static_cast<uint64_t>(index) << 48 |
+            static_cast<uint64_t>(generation & 0xFFFF) << 32 | slot) {
+  }
+  std::size_t Index() const {
+    return _bits >> 48;
+  }
+  uint32_t Generation() const {
+    return (_bits >> 32) & 0xFFFF;
+  }
+  uint32_t Slot() const {
+    return static_cast<uint32_t>(_bits);
+  }
+  bool operator==(const PolyHandle& other) const = default;
+
+ private:
+  uint64_t _bits{~uint64_t{0}};
+};
+
+// every type in Ts... lives in its own dense std::vector, so for_each walks
+// plain arrays type by type with no per-element dispatch. erase moves the
+// last element of that type into the hole (swap-and-pop) and patches the
+// indirection table. raw pointers from get() are invalidated by any
+// emplace or erase of the same type; handles are not.
+template <typename... Ts>
+class PolyCollection {
+  static_assert(sizeof...(Ts) <= 0xFFFF, "type index must fit in 16 bits");
+
+ public:
+  using Pointer = TaggedPointer<Ts...>;
+
+  template <typename T, typename... Args>
+  PolyHandle emplace(Args&&... args) {
+    constexpr auto index = IndexOf<T, Ts...>();
+    static_assert(index >= 0, "Type T is not in the type list Ts...");
+    auto& arena = std::get<index>(_arenas);
+
+    uint32_t slot;
+    if (arena.freeSlot != kNone) {
+      slot = arena.freeSlot;
+      arena.freeSlot = arena.slots[slot].dense;
+    } else {
+      assert(arena.slots.size() < kNone);
+      slot = static_cast<uint32_t>(arena.slots.size());
+      arena.slots.push_back({});
+    }
+    arena.slots[slot].dense = static_cast<uint32_t>(arena.objects.size());
+    arena.objects.emplace_back(std::forward<Args>(args)...);
+    arena.owners.push_back(slot);
+    ++_size;
+    return PolyHandle(index, arena.slots[slot].generation, slot);
+  }
+
+  // returns false if the handle no longer refers to a live element
+  bool erase(PolyHandle handle) {
+    if (!contains(handle)) {
+      return false;
+    }
+    withArena(handle.Index(), [&](auto& arena) {
+      uint32_t slot = handle.Slot();
+      uint32_t hole = arena.slots[slot].dense;
+      uint32_t last = static_cast<uint32_t>(arena.objects.size() - 1);
+      if (hole != last) {
+        arena.objects[hole] = std::move(arena.objects[last]);
+        arena.owners[hole] = arena.owners[last];
+        arena.slots[arena.owners[hole]].dense = hole;
+      }
+      arena.objects.pop_back();
+      arena.owners.pop_back();
+      ++arena.slots[slot].generation;
+      arena.slots[slot].dense = arena.freeSlot;
+      arena.freeSlot = slot;
+    });
+    --_size;
+    return true;
+  }
+
+  bool contains(PolyHandle handle) const {
+    if (handle.Index() >= sizeof...(Ts)) {
+      return false;
+    }
+    bool live = false;
+    withArena(handle.Index(), [&](const auto& arena) {
+      live = handle.Slot() < arena.slots.size() &&
+             (arena.slots[handle.Slot()].generation & 0xFFFF) ==
+               handle.Generation() &&
+             arena.slots[handle.Slot()].dense < arena.objects.size() &&
+             arena.owners[arena.slots[handle.Slot()].dense] == handle.Slot();
+    });
+    return live;
+  }
+
+  // the element as a tagged pointer, so the usual Dispatch-based API works
+  // on it, e.g. get<Band>(handle).Vocal(). Ptr must accept every Ts*.
+  template <typename Ptr = Pointer>
+  Ptr get(PolyHandle handle) {
+    assert(contains(handle));
+    Ptr result{};
+    withArena(handle.Index(), [&](auto& arena) {
+      result = Ptr(&arena.objects[arena.slots[handle.Slot()].dense]);
+    });
+    return result;
+  }
+
+  // func(T*) for every element, one type after another
+  template <typename Func>
+  void for_each(Func&& func) {
+    std::apply([&](auto&... arena) { (forEachIn(arena, func), ...); },
+               _arenas);
+  }
+  template <typename T, typename Func>
+  void for_each(Func&& func) {
+    constexpr auto index = IndexOf<T, Ts...>();
+    static_assert(index >= 0, "Type T is not in the type list Ts...");
+    forEachIn(std::get<index>(_arenas), func);
+  }
+
+  template <typename T>
+  std::size_t count() const {
+    constexpr auto index = IndexOf<T, Ts...>();
+    static_assert(index >= 0, "Type T is not in the type list Ts...");
+    return std::get<index>(_arenas).objects.size();
+  }
+  std::size_t size() const {
+    return _size;
+  }
+  bool empty() const {
+    return _size == 0;
+  }
+
+ private:
+  static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+  struct Slot {
+    // dense position while live, next free slot while free
+    uint32_t dense = kNone;
+    uint32_t generation = 0;
+  };
+  template <typename T>
+  struct Arena {
+    std::vector<T> objects;
+    std::vector<uint32_t> owners;  // dense position -> slot
+    std::vector<Slot> slots;
+    uint32_t freeSlot = kNone;
+  };
+
+  template <typename Arena, typename Func>
+  static void forEachIn(Arena& arena, Func& func) {
+    for (auto& object : arena.objects) {
+      func(&object);
+    }
+  }
+
+  // runs func on the arena of the given type index, through a thunk table
+  template <std::size_t I, typename Self, typename Func>
+  static void arenaThunk(Self& self, Func& func) {
+    func(std::get<I>(self._arenas));
+  }
+  template <typename Self, typename Func, std::size_t... Is>
+  static void withArena(Self& self,
+                        std::size_t index,
+                        Func& func,
+                        std::index_sequence<Is...>) {
+    using Thunk = void (*)(Self&, Func&);
+    static constexpr Thunk table[] = {&arenaThunk<Is, Self, Func>...};
+    table[index](self, func);
+  }
+  template <typename Func>
+  void withArena(std::size_t index, Func&& func) {
+    withArena(*this, index, func, std::index_sequence_for<Ts...>{});
+  }
+  template <typename Func>
+  void withArena(std::size_t index, Func&& func) const {
+    withArena(*this, index, func, std::index_sequence_for<Ts...>{});
+  }
+
+  std::tuple<Arena<Ts>...> _arenas;
+  std::size_t _size = 0;
+};
+
+}  // namespace Taggedpointer
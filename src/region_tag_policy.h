@@ -0,0 +1,200 @@
+/*
+ * @Description: tag policy that derives the type from the address range
+ * @Author: lize
+ * @Date: 2025-10-31
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "slab_pool.h"
+#include "taggedpointer.h"
+
+namespace Taggedpointer {
+
+// one virtual-memory reservation split into `regions` equal regions of
+// 2^regionBits bytes. the whole reservation is aligned to its own size, so
+// (address >> regionBits) & (regions - 1) is the region of any address in
+// it. address space is reserved up front and committed in 1MiB steps as
+// Carve hands it out; it is never returned before the process exits.
+class RegionSpace {
+ public:
+  RegionSpace(int regionBits, std::size_t regions)
+    : _regionBytes(std::size_t{1} << regionBits),
+      _bytes(_regionBytes * regions),
+      _base(reserve(_bytes)),
+      _cursor(regions, 0),
+      _committed(regions, 0) {
+  }
+  RegionSpace(const RegionSpace&) = delete;
+  RegionSpace& operator=(const RegionSpace&) = delete;
+
+  bool Contains(uint64_t address) const {
+    auto base = reinterpret_cast<uint64_t>(_base);
+    return address >= base && address - base < _bytes;
+  }
+
+  // bump-allocates from one region. thread-safe; meant for slab-sized
+  // requests, not single objects.
+  void* Carve(std::size_t region, std::size_t bytes, std::size_t align) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::size_t offset = (_cursor[region] + align - 1) & ~(align - 1);
+    if (offset + bytes > _regionBytes) {
+      throw std::bad_alloc();
+    }
+    char* start = _base + region * _regionBytes;
+    std::size_t end = offset + bytes;
+    if (end > _committed[region]) {
+      std::size_t target = (end + kCommitStep - 1) & ~(kCommitStep - 1);
+      target = target < _regionBytes ? target : _regionBytes;
+      commit(start + _committed[region], target - _committed[region]);
+      _committed[region] = target;
+    }
+    _cursor[region] = end;
+    return start + offset;
+  }
+
+ private:
+  static constexpr std::size_t kCommitStep = std::size_t{1} << 20;
+
+  // reserves `bytes` of address space aligned to `bytes`
+  static char* reserve(std::size_t bytes) {
+    std::size_t span = bytes * 2;
+#ifdef _WIN32
+    void* raw = VirtualAlloc(nullptr, span, MEM_RESERVE, PAGE_NOACCESS);
+    if (raw == nullptr) {
+      throw std::bad_alloc();
+    }
+    auto begin = reinterpret_cast<uintptr_t>(raw);
+    return reinterpret_cast<char*>((begin + bytes - 1) & ~(bytes - 1));
+#else
+    void* raw = mmap(nullptr,
+                     span,
+                     PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                     -1,
+                     0);
+    if (raw == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto begin = reinterpret_cast<uintptr_t>(raw);
+    auto aligned = (begin + bytes - 1) & ~(bytes - 1);
+    if (aligned > begin) {
+      munmap(raw, aligned - begin);
+    }
+    if (begin + span > aligned + bytes) {
+      munmap(reinterpret_cast<void*>(aligned + bytes),
+             begin + span - (aligned + bytes));
+    }
+    return reinterpret_cast<char*>(aligned);
+#endif
+  }
+
+  static void commit(char* at, std::size_t bytes) {
+#ifdef _WIN32
+    if (VirtualAlloc(at, bytes, MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+      throw std::bad_alloc();
+    }
+#else
+    if (mprotect(at, bytes, PROT_READ | PROT_WRITE) != 0) {
+      throw std::bad_alloc();
+    }
+#endif
+  }
+
+  std::size_t _regionBytes;
+  std::size_t _bytes;
+  char* _base;
+  std::mutex _mutex;
+  std::vector<std::size_t> _cursor;
+  std::vector<std::size_t> _committed;
+};
+
+// the type index is the region the object lives in. the stored word is the
+// plain, canonical pointer: nothing is masked on dereference, so it works
+// with 5-level paging, sanitizers and hardware pointer tagging. Index is a
+// shift and a mask. objects must be allocated from the policy's Pool (as
+// UniqueTaggedPointer::Make does); Encode asserts that in debug builds.
+template <int RegionBits, typename... Ts>
+struct RegionTagLayout {
+  static_assert(sizeof...(Ts) > 0, "TaggedPointer needs at least one type");
+  static_assert((!IsInline<Ts>::value && ...),
+                "RegionTagPolicy tags addresses; Inline<T> has none");
+
+  static constexpr std::size_t kRegions = std::bit_ceil(sizeof...(Ts));
+  static constexpr int kIndexBits = std::countr_zero(kRegions);
+  static_assert(RegionBits + kIndexBits <= 46,
+                "the regions do not fit in a 47-bit user address space");
+  // the pointer is kept untouched, so no bits are left for anything else
+  static constexpr int kSpareBits = 0;
+
+  static uint64_t Encode(std::size_t index, const void* ptr) {
+    auto bits = reinterpret_cast<uint64_t>(ptr);
+    assert(ptr == nullptr || (Space().Contains(bits) && Index(bits) == index));
+    (void)index;
+    return bits;
+  }
+  static std::size_t Index(uint64_t bits) {
+    return (bits >> RegionBits) & (kRegions - 1);
+  }
+  static uint64_t Pointer(uint64_t bits) {
+    return bits;
+  }
+
+  static RegionSpace& Space() {
+    static RegionSpace space(RegionBits, kRegions);
+    return space;
+  }
+};
+
+// SlabPool upstream that carves slabs out of one region
+template <typename Layout, std::size_t Region>
+struct RegionSlabs {
+  static void* Allocate(std::size_t bytes, std::size_t align) {
+    return Layout::Space().Carve(Region, bytes, align);
+  }
+  static void Release(void*, std::size_t, std::size_t) {
+  }
+};
+
+namespace detail {
+template <int RegionBits, typename T, typename Types>
+struct RegionPool;
+template <int RegionBits, typename T, typename... Ts>
+struct RegionPool<RegionBits, T, std::tuple<Ts...>> {
+  static constexpr auto kIndex = IndexOf<T, Ts...>();
+  static_assert(kIndex >= 0, "Type T is not in the type list Ts...");
+  using type =
+    SlabPool<T, RegionSlabs<RegionTagLayout<RegionBits, Ts...>, kIndex>>;
+};
+}  // namespace detail
+
+// TaggedPointer<RegionTagPolicy<>, A, B> gives every type a 4GiB region by
+// default; pass a smaller RegionBits for many types or small heaps.
+template <int RegionBits = 32>
+struct RegionTagPolicy {
+  template <typename... Ts>
+  using Layout = RegionTagLayout<RegionBits, Ts...>;
+  template <typename T, typename Types>
+  using Pool = typename detail::RegionPool<RegionBits, T, Types>::type;
+};
+template <int RegionBits>
+struct IsTagPolicy<RegionTagPolicy<RegionBits>> : std::true_type {};
+
+}  // namespace Taggedpointer
@@ -0,0 +1,157 @@
+/*
+ * @Description: per-type slab allocator with thread-local free lists
+ * @Author: lize
+ * @Date: 2025-10-28
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Taggedpointer {
+
+// where SlabPool gets its slabs: the global heap unless told otherwise
+struct HeapSlabs {
+  static void* Allocate(std::size_t bytes, std::size_t align) {
+    return ::operator new(bytes, std::align_val_t(align));
+  }
+  static void Release(void* slab, std::size_t bytes, std::size_t align) {
+    ::operator delete(slab, bytes, std::align_val_t(align));
+  }
+};
+
+// objects of one type are carved out of 64KiB slabs. each thread keeps its
+// own intrusive free list, so New/Delete are a few pointer moves and never
+// call malloc once the slabs are warm. slabs are only returned to Upstream
+// at exit. a thread that frees more than it allocates, such as the consumer
+// of objects made on another thread, hands a slab's worth of blocks back
+// to the shared list whenever its own list grows past two slabs' worth,
+// and the rest goes back when it exits.
+template <typename T, typename Upstream = HeapSlabs>
+class SlabPool {
+  union Block {
+    Block* next;
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+  static constexpr std::size_t kSlabBytes = 64 * 1024;
+  static constexpr std::size_t kBlocksPerSlab =
+    sizeof(Block) < kSlabBytes ? kSlabBytes / sizeof(Block) : 1;
+
+ public:
+  template <typename... Args>
+  static T* New(Args&&... args) {
+    void* memory = Allocate();
+    try {
+      return ::new (memory) T(std::forward<Args>(args)...);
+    } catch (...) {
+      Deallocate(memory);
+      throw;
+    }
+  }
+
+  static void Delete(T* ptr) {
+    if (ptr == nullptr) {
+      return;
+    }
+    ptr->~T();
+    Deallocate(ptr);
+  }
+
+  static void* Allocate() {
+    Local& local = localList();
+    if (local.head == nullptr) [[unlikely]] {
+      local.head = shared().refill(local.count);
+    }
+    Block* block = local.head;
+    local.head = block->next;
+    --local.count;
+    return block->storage;
+  }
+
+  static void Deallocate(void* ptr) {
+    Local& local = localList();
+    auto* block = static_cast<Block*>(ptr);
+    block->next = local.head;
+    local.head = block;
+    if (++local.count >= 2 * kBlocksPerSlab) [[unlikely]] {
+      // the most recently freed slab's worth; the walk is paid for by the
+      // kBlocksPerSlab frees since the last one
+      Block* last = block;
+      for (std::size_t i = 1; i < kBlocksPerSlab; ++i) {
+        last = last->next;
+      }
+      local.head = std::exchange(last->next, nullptr);
+      local.count -= kBlocksPerSlab;
+      shared().giveBack(block, last, kBlocksPerSlab);
+    }
+  }
+
+ private:
+  struct Shared {
+    // hands out the whole shared free list, or a fresh slab if it is empty,
+    // and how many blocks that is
+    Block* refill(std::size_t& taken) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (head != nullptr) {
+        taken = std::exchange(count, 0);
+        return std::exchange(head, nullptr);
+      }
+      taken = kBlocksPerSlab;
+      auto* slab = static_cast<Block*>(
+        Upstream::Allocate(kBlocksPerSlab * sizeof(Block), alignof(Block)));
+      slabs.push_back(slab);
+      for (std::size_t i = 0; i + 1 < kBlocksPerSlab; ++i) {
+        slab[i].next = &slab[i + 1];
+      }
+      slab[kBlocksPerSlab - 1].next = nullptr;
+      return slab;
+    }
+    // first to last is a chain of n blocks
+    void giveBack(Block* first, Block* last, std::size_t n) {
+      std::lock_guard<std::mutex> lock(mutex);
+      last->next = head;
+      head = first;
+      count += n;
+    }
+
+    ~Shared() {
+      for (Block* slab : slabs) {
+        Upstream::Release(slab, kBlocksPerSlab * sizeof(Block), alignof(Block));
+      }
+    }
+
+    std::mutex mutex;
+    Block* head = nullptr;
+    std::size_t count = 0;
+    std::vector<Block*> slabs;
+  };
+
+  struct Local {
+    Block* head = nullptr;
+    std::size_t count = 0;
+    ~Local() {
+      if (head != nullptr) {
+        Block* last = head;
+        while (last->next) {
+          last = last->next;
+        }
+        shared().giveBack(head, last, count);
+      }
+    }
+  };
+
+  static Shared& shared() {
+    static Shared instance;
+    return instance;
+  }
+  static Local& localList() {
+    thread_local Local local;
+    return local;
+  }
+};
+
+}  // namespace Taggedpointer
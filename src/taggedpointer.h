@@ -6,11 +6,18 @@
  */
 
 #pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
 #include <tuple>
 #include <type_traits>
+
+#include "slab_pool.h"
+#include "utils/trace_scope.h"
+
 namespace Taggedpointer {
 
 // template <typename, typename...>
@@ -25,6 +32,12 @@ namespace Taggedpointer {
 #define FUNC_SIG __func__
 #endif
 
+#ifdef _MSC_VER
+#define TAGGED_POINTER_UNREACHABLE() __assume(0)
+#else
+#define TAGGED_POINTER_UNREACHABLE() __builtin_unreachable()
+#endif
+
 template <typename... Ts>
 void dump() {
   std::cout << FUNC_SIG << std::endl;
@@ -32,41 +45,517 @@ void dump() {
 
 template <typename T, typename... Ts>
 constexpr int64_t IndexOf() {
-  int64_t index = 0, cur = 0;
-  (((std::is_same_v<T, Ts>) ? (index = cur), true : (++cur), false) || ...);
-  return cur >= sizeof...(Ts) ? -1 : index;
+  int64_t index = 0;
+  bool found = ((std::is_same_v<T, Ts> ? true : (++index, false)) || ...);
+  return found ? index : -1;
 }
 
+// Inline<T> in the type list stores a T by value in the address bits instead
+// of pointing to one: integers that fit in 48 bits, bool, enums and float.
+// double does not fit beside a tag and needs NanBoxTagPolicy. Dispatch hands
+// the visitor the T itself for these types.
+template <typename T>
+struct Inline {
+  static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                "Inline<T> holds integers, bool, enums and floating point");
+  static_assert(sizeof(T) <= 4 || !std::is_floating_point_v<T> ||
+                  std::is_same_v<T, double>,
+                "Inline<T> floating point is float or double");
+  using type = T;
+};
+
+template <typename T>
+struct IsInline : std::false_type {};
+template <typename T>
+struct IsInline<Inline<T>> : std::true_type {};
+
+// bits at the top of a user-space pointer that are always zero: 16 with
+// 4-level paging (48-bit addresses). define as 7 for 5-level paging.
+#ifndef TAGGED_POINTER_HIGH_BITS
+#define TAGGED_POINTER_HIGH_BITS 16
+#endif
+
+// dense binary encoding of the type index. the index takes the top bits of
+// the free high region; if it needs more bits than HighBits it spills into
+// the low bits that alignof(Ts)... guarantees to be zero. the high bits the
+// index leaves over are spare; Dispatch ignores them.
+//
+//   63       64-HighBits                               0
+//   [ index hi | spare ][        address       | index lo ]
+template <int HighBits, typename... Ts>
+struct BasicTagLayout {
+  static_assert(sizeof...(Ts) > 0, "TaggedPointer needs at least one type");
+  static_assert(IndexOf<Inline<double>, Ts...>() < 0,
+                "Inline<double> needs NanBoxTagPolicy");
+
+  static constexpr int kTagBits = std::bit_width(sizeof...(Ts) - 1);
+  static constexpr int kAlignBits =
+    std::countr_zero(std::min({alignof(Ts)...}));
+  static constexpr int kHighTagBits = std::min(kTagBits, HighBits);
+  static constexpr int kLowTagBits = kTagBits - kHighTagBits;
+  static_assert(kLowTagBits <= kAlignBits,
+                "too many types for the free high bits and alignof(Ts)...");
+
+  static constexpr int kHighShift = 64 - kHighTagBits;
+  static constexpr uint64_t kLowMask = (uint64_t{1} << kLowTagBits) - 1;
+  static constexpr uint64_t kPointerMask =
+    (~uint64_t{0} >> HighBits) & ~kLowMask;
+
+  static constexpr int kSpareBits = HighBits - kHighTagBits;
+  static constexpr int kSpareShift = 64 - HighBits;
+  static constexpr uint64_t kSpareMask = ((uint64_t{1} << kSpareBits) - 1)
+                                         << kSpareShift;
+
+  static uint64_t Encode(std::size_t index, const void* ptr) {
+    auto bits = reinterpret_cast<uint64_t>(ptr);
+    assert((bits & ~kPointerMask) == 0);
+    if constexpr (kHighTagBits > 0) {
+      bits |= static_cast<uint64_t>(index >> kLowTagBits) << kHighShift;
+    }
+    return bits | (index & kLowMask);
+  }
+  static std::size_t Index(uint64_t bits) {
+    std::size_t index = 0;
+    if constexpr (kHighTagBits > 0) {
+      index = bits >> kHighShift;
+    }
+    return index << kLowTagBits | (bits & kLowMask);
+  }
+  static uint64_t Pointer(uint64_t bits) {
+    return bits & kPointerMask;
+  }
+  static uint64_t Spare(uint64_t bits) {
+    return (bits & kSpareMask) >> kSpareShift;
+  }
+  static uint64_t WithSpare(uint64_t bits, uint64_t spare) {
+    return (bits & ~kSpareMask) | ((spare << kSpareShift) & kSpareMask);
+  }
+};
+
+template <typename... Ts>
+using TagLayout = BasicTagLayout<TAGGED_POINTER_HIGH_BITS, Ts...>;
+
+// TaggedPointer<Payload<4>, A, B> keeps a 4-bit user value in the word next
+// to the tag, e.g. a refcount, a size class or a dirty flag.
+template <int Bits>
+struct Payload {
+  static_assert(Bits > 0 && Bits < 64, "Payload<Bits> needs 1..63 bits");
+};
+
+// takes the payload from the top of Base's spare bits. what is left below it
+// stays spare (AtomicTaggedPointer keeps its generation there):
+//
+//   [ index hi | payload | spare ][ address | index lo ]
+template <typename Base, int Bits>
+struct PayloadLayout : Base {
+  static_assert(Bits <= Base::kSpareBits,
+                "Payload<Bits> does not fit in the bits the tag leaves spare");
+
+  static constexpr int kPayloadBits = Bits;
+  static constexpr int kPayloadShift =
+    Base::kSpareShift + Base::kSpareBits - Bits;
+  static constexpr uint64_t kPayloadMask = ((uint64_t{1} << Bits) - 1)
+                                           << kPayloadShift;
+
+  static constexpr int kSpareBits = Base::kSpareBits - Bits;
+  static constexpr int kSpareShift = Base::kSpareShift;
+  static constexpr uint64_t kSpareMask = ((uint64_t{1} << kSpareBits) - 1)
+                                         << kSpareShift;
+
+  static uint64_t Payload(uint64_t bits) {
+    return (bits & kPayloadMask) >> kPayloadShift;
+  }
+  static uint64_t WithPayload(uint64_t bits, uint64_t payload) {
+    return (bits & ~kPayloadMask) | ((payload << kPayloadShift) & kPayloadMask);
+  }
+  static uint64_t Spare(uint64_t bits) {
+    return (bits & kSpareMask) >> kSpareShift;
+  }
+  static uint64_t WithSpare(uint64_t bits, uint64_t spare) {
+    return (bits & ~kSpareMask) | ((spare << kSpareShift) & kSpareMask);
+  }
+};
+
+// a tag policy decides where the type index is kept. it may lead the
+// parameter list, e.g. TaggedPointer<RegionTagPolicy<>, A, B>; without one
+// BitTagPolicy is used. options (a policy, Payload<Bits>) come before the
+// types, in any order. a policy provides Layout<Ts...> with Encode, Index
+// and Pointer like BasicTagLayout, and Pool<T, std::tuple<Ts...>>, the
+// allocator owning handles use for a T.
+//
+// policies are recognised by specializing IsTagPolicy rather than by a base
+// class, so the other parameters may still be incomplete types.
+template <typename T>
+struct IsTagPolicy : std::false_type {};
+
+struct BitTagPolicy {
+  template <typename... Ts>
+  using Layout = TagLayout<Ts...>;
+  template <typename T, typename Types>
+  using Pool = SlabPool<T>;
+};
+template <>
+struct IsTagPolicy<BitTagPolicy> : std::true_type {};
+
+namespace detail {
+// splits the leading options off TaggedPointer's parameter list
+template <typename Policy, int PayloadBits, typename... Ts>
+struct ParseOptions {
+  using policy = Policy;
+  using types = std::tuple<Ts...>;
+  static constexpr int payloadBits = PayloadBits;
+  using layout = std::conditional_t<
+    PayloadBits == 0,
+    typename Policy::template Layout<Ts...>,
+    PayloadLayout<typename Policy::template Layout<Ts...>, PayloadBits>>;
+};
+template <typename Policy, int PayloadBits, typename T, typename... Ts>
+  requires IsTagPolicy<T>::value
+struct ParseOptions<Policy, PayloadBits, T, Ts...>
+  : ParseOptions<T, PayloadBits, Ts...> {};
+template <typename Policy, int PayloadBits, int Bits, typename... Ts>
+struct ParseOptions<Policy, PayloadBits, Payload<Bits>, Ts...>
+  : ParseOptions<Policy, Bits, Ts...> {};
+
+// the field an Inline<T> value occupies in place of the address: 48 bits,
+// signed integers sign-extended
+inline constexpr uint64_t kBoxMask = (uint64_t{1} << 48) - 1;
+
+template <typename T>
+uint64_t boxBits(T value) {
+  if constexpr (std::is_enum_v<T>) {
+    return boxBits(static_cast<std::underlying_type_t<T>>(value));
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return std::bit_cast<uint32_t>(value);
+  } else if constexpr (std::is_signed_v<T>) {
+    assert(value >= -(int64_t{1} << 47) && value < (int64_t{1} << 47));
+    return static_cast<uint64_t>(value) & kBoxMask;
+  } else {
+    assert(static_cast<uint64_t>(value) <= kBoxMask);
+    return static_cast<uint64_t>(value);
+  }
+}
+
+template <typename T>
+T unboxBits(uint64_t bits) {
+  if constexpr (std::is_enum_v<T>) {
+    return static_cast<T>(unboxBits<std::underlying_type_t<T>>(bits));
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return bits != 0;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return std::bit_cast<T>(static_cast<uint32_t>(bits));
+  } else if constexpr (std::is_signed_v<T>) {
+    return static_cast<T>(static_cast<int64_t>(bits << 16) >> 16);
+  } else {
+    return static_cast<T>(bits);
+  }
+}
+
+// what Dispatch passes for a type list entry: T* or the inline value
+template <typename T>
+struct DispatchArg {
+  using type = T*;
+};
+template <typename T>
+struct DispatchArg<Inline<T>> {
+  using type = T;
+};
+
+// std::common_type of what func returns for every alternative
+template <typename Func, typename Types>
+struct VisitResult;
+template <typename Func, typename... Ts>
+struct VisitResult<Func, std::tuple<Ts...>> {
+  using type = std::common_type_t<
+    std::invoke_result_t<Func, typename DispatchArg<Ts>::type>...>;
+};
+// ... and for every pair of alternatives
+template <typename Func, typename TypesA, typename TypesB>
+struct VisitResult2;
+template <typename Func, typename... As, typename... Bs>
+struct VisitResult2<Func, std::tuple<As...>, std::tuple<Bs...>> {
+  template <typename A>
+  using Row = std::common_type_t<
+    std::invoke_result_t<Func,
+                         typename DispatchArg<A>::type,
+                         typename DispatchArg<Bs>::type>...>;
+  using type = std::common_type_t<Row<As>...>;
+};
+
+template <typename T, typename Types>
+struct IndexIn;
+template <typename T, typename... Ts>
+struct IndexIn<T, std::tuple<Ts...>>
+  : std::integral_constant<int64_t, IndexOf<T, Ts...>()> {};
+}  // namespace detail
+
 template <typename... Ts>
 class TaggedPointer {
+  using Options = detail::ParseOptions<BitTagPolicy, 0, Ts...>;
+
  public:
+  using Policy = typename Options::policy;
+  using Types = typename Options::types;
+  using Layout = typename Options::layout;
+  static constexpr int kPayloadBits = Options::payloadBits;
+  static constexpr std::size_t kTypeCount = std::tuple_size_v<Types>;
+  template <std::size_t I>
+  using TypeAt = std::tuple_element_t<I, Types>;
+  template <typename T>
+  using Pool = typename Policy::template Pool<T, Types>;
+  // T* for pointer types, T for Inline<T>
+  template <std::size_t I>
+  using ArgAt = typename detail::DispatchArg<TypeAt<I>>::type;
+  template <typename Func>
+  using VisitResult = typename detail::VisitResult<Func&, Types>::type;
+
+  TaggedPointer() = default;
+
   template <typename T>
   TaggedPointer(T* ptr) {
-    auto index = IndexOf<T, Ts...>();
+    constexpr auto index = detail::IndexIn<T, Types>::value;
+    static_assert(index >= 0, "Type T is not in the type list Ts...");
     // dump<T, Ts...>();
-    assert(index >= 0);
-    int64_t mask = index == 0 ? 0LL : 1LL << (index - 1 + 63 - 7);
-    _ptr = reinterpret_cast<uint64_t>(ptr) | mask;
+    _ptr = Layout::Encode(index, ptr);
+  }
+  template <typename T>
+  TaggedPointer(T* ptr, uint64_t payload) : TaggedPointer(ptr) {
+    set_payload(payload);
+  }
+
+  // boxes a value of an Inline<V> type; V must match exactly, as T* does.
+  template <typename V>
+    requires(detail::IndexIn<Inline<V>, Types>::value >= 0)
+  TaggedPointer(V value) {
+    constexpr auto index = detail::IndexIn<Inline<V>, Types>::value;
+    if constexpr (std::is_same_v<V, double>) {
+      _ptr = Layout::BoxDouble(value);
+    } else {
+      _ptr = Layout::Encode(
+        index, reinterpret_cast<const void*>(detail::boxBits(value)));
+    }
   }
 
+  // O(1) dispatch. up to 16 types the tag selects a case of a switch that
+  // the compiler lowers to a jump table with the visitor inlined into every
+  // case; beyond that it indexes a compile-time table of thunks. func gets
+  // ArgAt<I>: a T* or, for Inline<T>, the T. Every alternative must return
+  // the same type, which Dispatch returns.
   template <typename Func>
-  void Dispatch(Func func) {
-    int64_t index = _ptr >> (63 - 7);
-    dispatch_imp(func, index, std::index_sequence_for<Ts...>{});
+  decltype(auto) Dispatch(Func&& func) {
+    LZ_TRACE_SCOPE("taggedpointer.dispatch");
+    using Result = std::invoke_result_t<Func&, ArgAt<0>>;
+    static_assert(sameResult<Result, Func>(Indices{}),
+                  "Dispatch requires the same return type for every type");
+    auto index = Index();
+    assert(index < kTypeCount);
+    if constexpr (kTypeCount <= kSwitchLimit) {
+      return dispatch_switch<Result>(func, index, _ptr);
+    } else {
+      return dispatch_table<Result>(func, index, _ptr, Indices{});
+    }
+  }
+
+  // like Dispatch, but the alternatives may return different types: the
+  // result is their std::common_type and each is converted to it.
+  template <typename Func>
+  auto Visit(Func&& func) const -> VisitResult<Func> {
+    using Result = VisitResult<Func>;
+    auto convert = [&func](auto arg) -> Result { return func(arg); };
+    auto index = Index();
+    assert(index < kTypeCount);
+    if constexpr (kTypeCount <= kSwitchLimit) {
+      return dispatch_switch<Result>(convert, index, _ptr);
+    } else {
+      return dispatch_table<Result>(convert, index, _ptr, Indices{});
+    }
+  }
+
+  // linear dispatch with a || fold over every index. kept as the reference
+  // implementation for benchmark/dispatch_benchmark.cpp.
+  template <typename Func>
+  void DispatchFold(Func func) {
+    int64_t index = Layout::Index(_ptr);
+    dispatch_imp(func, index, Indices{});
+  }
+
+  std::size_t Index() const {
+    return Layout::Index(_ptr);
+  }
+
+  // the Payload<Bits> value. it is part of Raw() and operator==, but not of
+  // the pointer Dispatch and Get hand out.
+  uint64_t payload() const {
+    static_assert(kPayloadBits > 0, "declare the field with Payload<Bits>");
+    return Layout::Payload(_ptr);
+  }
+  void set_payload(uint64_t payload) {
+    static_assert(kPayloadBits > 0, "declare the field with Payload<Bits>");
+    assert(payload >> kPayloadBits == 0);
+    _ptr = Layout::WithPayload(_ptr, payload);
+  }
+
+  // the pointer if it currently holds a T, else nullptr.
+  template <typename T>
+  T* Get() const {
+    constexpr auto index = detail::IndexIn<T, Types>::value;
+    static_assert(index >= 0, "Type T is not in the type list Ts...");
+    return Index() == index ? reinterpret_cast<T*>(Layout::Pointer(_ptr))
+                            : nullptr;
+  }
+
+  // the value of an Inline<V> type; it must be the one currently held.
+  template <typename V>
+  V Value() const {
+    constexpr auto index = detail::IndexIn<Inline<V>, Types>::value;
+    static_assert(index >= 0, "Type Inline<V> is not in the type list Ts...");
+    assert(Index() == index);
+    return Decode<index>(_ptr);
+  }
+
+  // false for a null pointer. an inline value is never null, not even 0, so
+  // a default-constructed pointer is true if its first type is Inline<T>.
+  explicit operator bool() const {
+    if constexpr (kAnyInline) {
+      if (kIsInline[Index()]) {
+        return true;
+      }
+    }
+    return Layout::Pointer(_ptr) != 0;
+  }
+  bool operator==(const TaggedPointer& other) const = default;
+
+  // the encoded word, for code that stores or exchanges it as a whole.
+  uint64_t Raw() const {
+    return _ptr;
+  }
+  static TaggedPointer FromRaw(uint64_t bits) {
+    TaggedPointer tp;
+    tp._ptr = bits;
+    return tp;
+  }
+
+  // what Dispatch would pass the I-th alternative for an encoded word. the
+  // tag is not checked; for code that has already switched on Index().
+  template <std::size_t I>
+  static ArgAt<I> Decode(uint64_t bits) {
+    if constexpr (!IsInline<TypeAt<I>>::value) {
+      return reinterpret_cast<ArgAt<I>>(Layout::Pointer(bits));
+    } else if constexpr (std::is_same_v<ArgAt<I>, double>) {
+      return Layout::UnboxDouble(bits);
+    } else {
+      return detail::unboxBits<ArgAt<I>>(Layout::Pointer(bits));
+    }
   }
 
  private:
+  using Indices = std::make_index_sequence<kTypeCount>;
+  static constexpr std::size_t kSwitchLimit = 16;
+
+  static constexpr auto kIsInline =
+    []<std::size_t... Is>(std::index_sequence<Is...>) {
+      return std::array<bool, kTypeCount>{IsInline<TypeAt<Is>>::value...};
+    }(Indices{});
+  static constexpr bool kAnyInline =
+    std::find(kIsInline.begin(), kIsInline.end(), true) != kIsInline.end();
+
+  template <typename Result, typename Func, std::size_t... Is>
+  static constexpr bool sameResult(std::index_sequence<Is...>) {
+    return (std::is_same_v<Result, std::invoke_result_t<Func&, ArgAt<Is>>> &&
+            ...);
+  }
+
+  template <typename Func, typename Result, std::size_t I>
+  static Result thunk(Func& func, uint64_t bits) {
+    return func(Decode<I>(bits));
+  }
+
+  template <typename Result, typename Func, std::size_t... Is>
+  static Result dispatch_table(Func& func,
+                               std::size_t index,
+                               uint64_t bits,
+                               std::index_sequence<Is...>) {
+    using Thunk = Result (*)(Func&, uint64_t);
+    static constexpr Thunk table[] = {&thunk<Func, Result, Is>...};
+    return table[index](func, bits);
+  }
+
+  template <typename Result, typename Func>
+  static Result dispatch_switch(Func& func, std::size_t index, uint64_t bits) {
+#define TAGGED_POINTER_CASE(I)      \
+  case I:                           \
+    if constexpr (I < kTypeCount) { \
+      return func(Decode<I>(bits)); \
+    }                               \
+    break;
+    switch (index) {
+      TAGGED_POINTER_CASE(0)
+      TAGGED_POINTER_CASE(1)
+      TAGGED_POINTER_CASE(2)
+      TAGGED_POINTER_CASE(3)
+      TAGGED_POINTER_CASE(4)
+      TAGGED_POINTER_CASE(5)
+      TAGGED_POINTER_CASE(6)
+      TAGGED_POINTER_CASE(7)
+      TAGGED_POINTER_CASE(8)
+      TAGGED_POINTER_CASE(9)
+      TAGGED_POINTER_CASE(10)
+      TAGGED_POINTER_CASE(11)
+      TAGGED_POINTER_CASE(12)
+      TAGGED_POINTER_CASE(13)
+      TAGGED_POINTER_CASE(14)
+      TAGGED_POINTER_CASE(15)
+      default:
+        break;
+    }
+#undef TAGGED_POINTER_CASE
+    TAGGED_POINTER_UNREACHABLE();
+  }
+
   template <typename Func, std::size_t... Is>
   auto dispatch_imp(Func func, int64_t index, std::index_sequence<Is...>) {
-    (((index == Is)
-        ? (func(reinterpret_cast<std::tuple_element_t<Is, std::tuple<Ts...>>*>(
-             _ptr & 0x00FFFFFFFFFFFFFF)),
-           true)
-        : false) ||
-     ...);
+    (((index == Is) ? (func(Decode<Is>(_ptr)), true) : false) || ...);
   }
 
   uint64_t _ptr{0};
 };
 
+namespace detail {
+template <typename Result, typename Func, typename A, typename B, std::size_t K>
+Result visitThunk(Func& func, uint64_t a, uint64_t b) {
+  return func(A::template Decode<K / B::kTypeCount>(a),
+              B::template Decode<K % B::kTypeCount>(b));
+}
+template <typename Result, typename Func, typename A, typename B,
+          std::size_t... Ks>
+Result visitTable(Func& func,
+                  std::size_t cell,
+                  uint64_t a,
+                  uint64_t b,
+                  std::index_sequence<Ks...>) {
+  using Thunk = Result (*)(Func&, uint64_t, uint64_t);
+  static constexpr Thunk table[] = {&visitThunk<Result, Func, A, B, Ks>...};
+  return table[cell](func, a, b);
+}
+}  // namespace detail
+
+// double dispatch: func(a's alternative, b's alternative), through one
+// compile-time table of A::kTypeCount * B::kTypeCount thunks. A and B are
+// TaggedPointers or handles derived from them, e.g. Visit(collide, x, y).
+// the result is the common type of every pair's result.
+template <typename Func, typename A, typename B>
+auto Visit(Func&& func, const A& a, const B& b) ->
+  typename detail::VisitResult2<Func&,
+                                typename A::Types,
+                                typename B::Types>::type {
+  using Result = typename detail::
+    VisitResult2<Func&, typename A::Types, typename B::Types>::type;
+  auto convert = [&func](auto x, auto y) -> Result { return func(x, y); };
+  constexpr std::size_t kCells = A::kTypeCount * B::kTypeCount;
+  std::size_t cell = a.Index() * B::kTypeCount + b.Index();
+  assert(cell < kCells);
+  return detail::visitTable<Result, decltype(convert), A, B>(
+    convert, cell, a.Raw(), b.Raw(), std::make_index_sequence<kCells>{});
+}
+
 }  // namespace Taggedpointer
\ No newline at end of file
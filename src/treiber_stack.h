@@ -0,0 +1,101 @@
+/*
+ * @Description: lock-free Treiber stack on AtomicTaggedPointer
+ * @Author: lize
+ * @Date: 2025-10-27
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+#include "atomic_taggedpointer.h"
+
+namespace Taggedpointer {
+
+// nodes are never freed while the stack lives: popped nodes go to a second
+// lock-free free list and get reused by push. so a thread that read a stale
+// head can still safely read its next, and the generation in the head makes
+// its CAS fail.
+template <typename T>
+class TreiberStack {
+  struct Node {
+    std::optional<T> value;
+    std::atomic<Node*> next{nullptr};
+  };
+  using Head = AtomicTaggedPointer<Node>;
+  using NodePtr = typename Head::Pointer;
+
+ public:
+  TreiberStack() = default;
+  TreiberStack(const TreiberStack&) = delete;
+  TreiberStack& operator=(const TreiberStack&) = delete;
+  ~TreiberStack() {
+    freeAll(_head);
+    freeAll(_free);
+  }
+
+  template <typename... Args>
+  void push(Args&&... args) {
+    Node* node = take(_free);
+    if (node == nullptr) {
+      node = new Node();
+    }
+    node->value.emplace(std::forward<Args>(args)...);
+    put(_head, node);
+  }
+
+  std::optional<T> pop() {
+    Node* node = take(_head);
+    if (node == nullptr) {
+      return std::nullopt;
+    }
+    std::optional<T> value = std::move(node->value);
+    node->value.reset();
+    put(_free, node);
+    return value;
+  }
+
+  bool empty() const {
+    return !_head.load(std::memory_order_acquire);
+  }
+
+ private:
+  static void put(Head& head, Node* node) {
+    NodePtr top = head.load(std::memory_order_relaxed);
+    do {
+      node->next.store(top.template Get<Node>(), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(top,
+                                         NodePtr(node),
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  static Node* take(Head& head) {
+    NodePtr top = head.load(std::memory_order_acquire);
+    while (top) {
+      Node* node = top.template Get<Node>();
+      Node* next = node->next.load(std::memory_order_relaxed);
+      if (head.compare_exchange_weak(top,
+                                     NodePtr(next),
+                                     std::memory_order_acquire,
+                                     std::memory_order_acquire)) {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  static void freeAll(Head& head) {
+    Node* node = head.load(std::memory_order_relaxed).template Get<Node>();
+    while (node) {
+      delete std::exchange(node, node->next.load(std::memory_order_relaxed));
+    }
+  }
+
+  Head _head;
+  Head _free;
+};
+
+}  // namespace Taggedpointer
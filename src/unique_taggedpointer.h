@@ -0,0 +1,80 @@
+/*
+ * @Description: owning, move-only TaggedPointer backed by SlabPool
+ * @Author: lize
+ * @Date: 2025-10-28
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <utility>
+
+#include "taggedpointer.h"
+
+namespace Taggedpointer {
+
+// owns the object a tagged handle points to. Handle is a TaggedPointer or a
+// class derived from one (e.g. Band), and operator-> exposes its API. the
+// object must come from Handle::Pool<T> (SlabPool<T> unless the tag policy
+// says otherwise), either via Make or a Create() that uses the pool; the
+// destructor dispatches to the concrete type to destroy it and return the
+// memory.
+template <typename Handle>
+class UniqueTaggedPointer {
+ public:
+  UniqueTaggedPointer() = default;
+  explicit UniqueTaggedPointer(Handle handle) : _handle(handle) {
+  }
+  UniqueTaggedPointer(const UniqueTaggedPointer&) = delete;
+  UniqueTaggedPointer& operator=(const UniqueTaggedPointer&) = delete;
+  UniqueTaggedPointer(UniqueTaggedPointer&& other) noexcept
+    : _handle(other.release()) {
+  }
+  UniqueTaggedPointer& operator=(UniqueTaggedPointer&& other) noexcept {
+    if (this != &other) {
+      reset(other.release());
+    }
+    return *this;
+  }
+  ~UniqueTaggedPointer() {
+    reset();
+  }
+
+  template <typename T, typename... Args>
+  static UniqueTaggedPointer Make(Args&&... args) {
+    return UniqueTaggedPointer(
+      Handle(Handle::template Pool<T>::New(std::forward<Args>(args)...)));
+  }
+
+  Handle* operator->() {
+    return &_handle;
+  }
+  const Handle* operator->() const {
+    return &_handle;
+  }
+  Handle get() const {
+    return _handle;
+  }
+  explicit operator bool() const {
+    return static_cast<bool>(_handle);
+  }
+
+  Handle release() {
+    return std::exchange(_handle, Handle());
+  }
+  void reset(Handle handle = Handle()) {
+    Handle old = std::exchange(_handle, handle);
+    if (old) {
+      old.Dispatch([](auto ptr) { destroy(ptr); });
+    }
+  }
+
+ private:
+  template <typename T>
+  static void destroy(T* ptr) {
+    Handle::template Pool<T>::Delete(ptr);
+  }
+
+  Handle _handle{};
+};
+
+}  // namespace Taggedpointer
@@ -0,0 +1,96 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-10-29
+ * @LastEditors: lize
+ */
+
+#include "batch_dispatch.h"
+
+#include <gtest/gtest.h>
+
+#include <span>
+#include <vector>
+
+namespace lz {
+namespace test {
+using Taggedpointer::BatchOrder;
+using Taggedpointer::DispatchAll;
+using Taggedpointer::TaggedPointer;
+
+struct Red {
+  int id;
+};
+struct Green {
+  int id;
+};
+struct Blue {
+  int id;
+};
+using Color = TaggedPointer<Red, Green, Blue>;
+
+class BatchDispatchTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    // ids follow container order, types are interleaved
+    for (int i = 0; i < 12; ++i) {
+      switch (i % 3) {
+        case 0:
+          _reds.push_back({i});
+          break;
+        case 1:
+          _greens.push_back({i});
+          break;
+        default:
+          _blues.push_back({i});
+      }
+    }
+    for (int i = 0; i < 4; ++i) {
+      _handles.emplace_back(&_blues[i]);
+      _handles.emplace_back(&_reds[i]);
+      _handles.emplace_back(&_greens[i]);
+    }
+  }
+  std::vector<int> visit(BatchOrder order) {
+    std::vector<int> ids;
+    DispatchAll(
+      _handles, [&ids](auto ptr) { ids.push_back(ptr->id); }, order);
+    return ids;
+  }
+
+  std::vector<Red> _reds;
+  std::vector<Green> _greens;
+  std::vector<Blue> _blues;
+  std::vector<Color> _handles;
+};
+
+TEST_F(BatchDispatchTest, GroupsByTypeAndKeepsOrderWithinType) {
+  auto ids = visit(BatchOrder::Keep);
+  std::vector<int> expected{0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11};
+  EXPECT_EQ(ids, expected);
+}
+
+TEST_F(BatchDispatchTest, KeepLeavesContainerAlone) {
+  auto before = _handles;
+  visit(BatchOrder::Keep);
+  EXPECT_EQ(_handles, before);
+}
+
+TEST_F(BatchDispatchTest, PartitionGroupsContainer) {
+  visit(BatchOrder::Partition);
+  for (std::size_t i = 0; i < _handles.size(); ++i) {
+    EXPECT_EQ(_handles[i].Index(), i / 4);
+  }
+  EXPECT_EQ(_handles[0].Get<Red>(), &_reds[0]);
+  EXPECT_EQ(_handles[3].Get<Red>(), &_reds[3]);
+}
+
+TEST_F(BatchDispatchTest, ConstSpan) {
+  std::span<const Color> view(_handles);
+  int count = 0;
+  DispatchAll(view, [&count](auto) { ++count; });
+  EXPECT_EQ(count, 12);
+}
+
+}  // namespace test
+}  // namespace lz
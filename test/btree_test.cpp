@@ -0,0 +1,158 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-06
+ * @LastEditors: lize
+ */
+
+#include "utils/btree.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace lz {
+namespace test {
+using btree::BTree;
+
+TEST(BTreeTest, InsertFindRemove) {
+  BTree<int> tree;
+  EXPECT_EQ(tree.findMin(), nullptr);
+  for (int v : {5, 3, 8, 1, 4, 7, 9}) {
+    EXPECT_TRUE(tree.insert(v));
+  }
+  EXPECT_FALSE(tree.insert(4));
+  EXPECT_EQ(tree.size(), 7);
+  ASSERT_NE(tree.find(4), nullptr);
+  EXPECT_EQ(*tree.find(4), 4);
+  EXPECT_EQ(tree.find(6), nullptr);
+  EXPECT_EQ(*tree.findMin(), 1);
+
+  EXPECT_TRUE(tree.remove(1));
+  EXPECT_FALSE(tree.remove(1));
+  EXPECT_EQ(*tree.findMin(), 3);
+  EXPECT_EQ(tree.size(), 6);
+  EXPECT_TRUE(tree.checkBTree().first);
+}
+
+// the vector search must agree with plain < at the ends of the range and
+// across the sign bit of unsigned keys
+template <typename T>
+void expectSearchMatchesScalar() {
+  constexpr auto lo = std::numeric_limits<T>::min();
+  constexpr auto hi = std::numeric_limits<T>::max();
+  alignas(64) T keys[16] = {lo,
+                            static_cast<T>(lo + 1),
+                            static_cast<T>(-2),
+                            static_cast<T>(-1),
+                            0,
+                            1,
+                            static_cast<T>(hi / 2),
+                            static_cast<T>(hi / 2 + 1),
+                            static_cast<T>(hi - 1),
+                            hi};
+  std::sort(keys, keys + 10);
+  // the neighbours wrap around at lo and hi, in unsigned arithmetic
+  using Unsigned = std::make_unsigned_t<T>;
+  for (std::size_t count = 0; count <= 10; ++count) {
+    for (std::size_t i = 0; i < 10; ++i) {
+      auto bits = static_cast<Unsigned>(keys[i]);
+      for (T key :
+           {keys[i], static_cast<T>(bits - 1), static_cast<T>(bits + 1)}) {
+        EXPECT_EQ(btree::detail::countPrefix<true>(keys, count, key),
+                  std::lower_bound(keys, keys + count, key) - keys);
+        EXPECT_EQ(btree::detail::countPrefix<false>(keys, count, key),
+                  std::upper_bound(keys, keys + count, key) - keys);
+      }
+    }
+  }
+}
+
+TEST(BTreeTest, VectorSearchMatchesScalar) {
+  expectSearchMatchesScalar<int32_t>();
+  expectSearchMatchesScalar<uint32_t>();
+  expectSearchMatchesScalar<int64_t>();
+  expectSearchMatchesScalar<uint64_t>();
+  // not the same types as int64_t/uint64_t on LP64
+  expectSearchMatchesScalar<long long>();
+  expectSearchMatchesScalar<unsigned long long>();
+}
+
+// small nodes give deep trees, so splits and merges cascade
+template <typename Tree, typename Compare = std::less<>, typename Make>
+void churnAgainstStdSet(Make make) {
+  Tree tree;
+  std::set<decltype(make(0)), Compare> reference;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> key(0, 3000);
+  for (int step = 0; step < 30000; ++step) {
+    auto v = make(key(gen));
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.remove(v), reference.erase(v) == 1);
+    } else {
+      EXPECT_EQ(tree.insert(v), reference.insert(v).second);
+    }
+    if (step % 1000 == 0) {
+      ASSERT_TRUE(tree.checkBTree().first) << step;
+    }
+  }
+  EXPECT_TRUE(tree.checkBTree().first);
+  EXPECT_EQ(tree.size(), reference.size());
+  for (int k = 0; k <= 3000; ++k) {
+    EXPECT_EQ(tree.find(make(k)) != nullptr, reference.count(make(k)) == 1);
+  }
+  EXPECT_EQ(*tree.findMin(), *reference.begin());
+  // drain it
+  for (auto& v : reference) {
+    EXPECT_TRUE(tree.remove(v));
+  }
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.bytes(), 0);
+  EXPECT_TRUE(tree.checkBTree().first);
+}
+
+TEST(BTreeTest, MatchesStdSetUnderRandomChurn) {
+  churnAgainstStdSet<BTree<int>>([](int k) { return k - 1500; });
+  churnAgainstStdSet<BTree<int, std::less<int>, 64>>([](int k) { return k; });
+  churnAgainstStdSet<BTree<uint32_t>>(
+    [](int k) { return static_cast<uint32_t>(k) * 0x9E3779B9U; });
+  churnAgainstStdSet<BTree<int64_t, std::less<int64_t>, 128>>(
+    [](int k) { return (int64_t{k} - 1500) << 40; });
+  churnAgainstStdSet<BTree<uint64_t>>(
+    [](int k) { return uint64_t{static_cast<uint32_t>(k)} << 50; });
+  churnAgainstStdSet<BTree<std::string>>(
+    [](int k) { return std::to_string(k); });
+  churnAgainstStdSet<BTree<int, std::greater<int>, 64>, std::greater<int>>(
+    [](int k) { return k; });
+}
+
+TEST(BTreeTest, NodesFillCacheLines) {
+  using Tree = BTree<int>;
+  EXPECT_EQ(Tree::kLeafKeys % 8, 0);
+  EXPECT_EQ(Tree::kInnerKeys % 8, 0);
+  Tree tree;
+  for (int i = 0; i < 100000; ++i) {
+    tree.insert(i);
+  }
+  auto [valid, levels] = tree.checkBTree();
+  EXPECT_TRUE(valid);
+  EXPECT_LE(levels, 5);
+  // half-full leaves after ascending inserts, still under the RBTree's 16
+  EXPECT_LT(tree.bytes() / tree.size(), 12);
+
+  std::vector<int> seen;
+  EXPECT_EQ(
+    tree.for_each_in_range(500, 1000, [&](int v) { seen.push_back(v); }), 500);
+  EXPECT_EQ(seen.front(), 500);
+  EXPECT_EQ(seen.back(), 999);
+  EXPECT_EQ(tree.for_each_in_range(99990, 200000, [](int) {}), 10);
+}
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,132 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-01
+ * @LastEditors: lize
+ */
+
+#include "nanbox_tag_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace lz {
+namespace test {
+using Taggedpointer::Inline;
+using Taggedpointer::NanBoxTagPolicy;
+using Taggedpointer::TaggedPointer;
+
+enum class Color : uint8_t { Red, Green, Blue };
+
+struct Node {
+  std::string name = "node";
+};
+
+// names the alternative Dispatch handed over and prints its value
+struct Describe {
+  std::string operator()(int64_t v) const {
+    return "int " + std::to_string(v);
+  }
+  std::string operator()(bool v) const {
+    return v ? "true" : "false";
+  }
+  std::string operator()(float v) const {
+    return "float " + std::to_string(v);
+  }
+  std::string operator()(double v) const {
+    return "double " + std::to_string(v);
+  }
+  std::string operator()(Color v) const {
+    return "color " + std::to_string(static_cast<int>(v));
+  }
+  std::string operator()(Node* v) const {
+    return v->name;
+  }
+};
+
+TEST(InlineValueTest, BitLayoutKeepsValuesInTheAddressBits) {
+  using Value =
+    TaggedPointer<Inline<int64_t>, Inline<bool>, Inline<float>, Inline<Color>,
+                  Node>;
+  static_assert(sizeof(Value) == sizeof(uint64_t));
+  Node node;
+  constexpr int64_t kMax = (int64_t{1} << 47) - 1;
+
+  std::vector<Value> values = {
+    int64_t{-5}, kMax, -kMax - 1, true, 2.5f, Color::Blue, &node};
+  std::vector<std::string> names;
+  for (auto& value : values) {
+    names.push_back(value.Dispatch(Describe{}));
+  }
+  EXPECT_EQ(names[0], "int -5");
+  EXPECT_EQ(values[1].Value<int64_t>(), kMax);
+  EXPECT_EQ(values[2].Value<int64_t>(), -kMax - 1);
+  EXPECT_EQ(names[3], "true");
+  EXPECT_EQ(values[4].Value<float>(), 2.5f);
+  EXPECT_EQ(names[5], "color 2");
+  EXPECT_EQ(names[6], "node");
+  EXPECT_EQ(values[6].Get<Node>(), &node);
+}
+
+TEST(InlineValueTest, InlineValuesAreNeverNull) {
+  using Value = TaggedPointer<Node, Inline<int64_t>, Inline<bool>>;
+  EXPECT_FALSE(Value());
+  EXPECT_FALSE(Value(static_cast<Node*>(nullptr)));
+  EXPECT_TRUE(Value(int64_t{0}));
+  EXPECT_TRUE(Value(false));
+}
+
+using Boxed = TaggedPointer<NanBoxTagPolicy,
+                            Node,
+                            Inline<int64_t>,
+                            Inline<double>,
+                            Inline<bool>,
+                            Inline<Color>>;
+
+TEST(NanBoxTagPolicyTest, DoublesRoundTripBitExact) {
+  static_assert(sizeof(Boxed) == sizeof(uint64_t));
+  const double cases[] = {0.0,
+                          -0.0,
+                          1.5,
+                          -1e300,
+                          std::numeric_limits<double>::max(),
+                          std::numeric_limits<double>::lowest(),
+                          std::numeric_limits<double>::denorm_min(),
+                          std::numeric_limits<double>::infinity(),
+                          -std::numeric_limits<double>::infinity()};
+  for (double d : cases) {
+    Boxed boxed = d;
+    ASSERT_EQ(boxed.Index(), 2);
+    EXPECT_EQ(std::bit_cast<uint64_t>(boxed.Value<double>()),
+              std::bit_cast<uint64_t>(d));
+  }
+  Boxed nan = -std::numeric_limits<double>::quiet_NaN();
+  EXPECT_EQ(nan.Index(), 2);
+  EXPECT_TRUE(std::isnan(nan.Value<double>()));
+}
+
+TEST(NanBoxTagPolicyTest, PointersAndOtherValuesKeepWorking) {
+  Node node;
+  std::vector<Boxed> values = {
+    &node, int64_t{-42}, 0.25, true, Color::Green};
+  std::vector<std::string> names;
+  for (auto& value : values) {
+    names.push_back(value.Dispatch(Describe{}));
+  }
+  EXPECT_EQ(names[0], "node");
+  EXPECT_EQ(values[0].Get<Node>(), &node);
+  EXPECT_EQ(names[1], "int -42");
+  EXPECT_EQ(values[2].Value<double>(), 0.25);
+  EXPECT_EQ(names[3], "true");
+  EXPECT_EQ(names[4], "color 1");
+  EXPECT_FALSE(Boxed());
+  EXPECT_TRUE(Boxed(0.0));
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,156 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-08
+ * @LastEditors: lize
+ */
+
+#include "utils/persistent_rbtree.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace lz {
+namespace test {
+using rbtree::PersistentRBTree;
+
+TEST(PersistentRBTreeTest, MatchesStdSetUnderRandomChurn) {
+  PersistentRBTree<int> tree;
+  std::set<int> reference;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> key(0, 2000);
+  for (int step = 0; step < 20000; ++step) {
+    int v = key(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.remove(v), reference.erase(v) == 1);
+    } else {
+      EXPECT_EQ(tree.insert(v), reference.insert(v).second);
+    }
+    if (step % 1000 == 0) {
+      ASSERT_TRUE(tree.snapshot().checkRbTree().first) << step;
+    }
+  }
+  auto snapshot = tree.snapshot();
+  EXPECT_TRUE(snapshot.checkRbTree().first);
+  EXPECT_EQ(snapshot.size(), reference.size());
+  std::vector<int> values;
+  snapshot.for_each([&](int v) { values.push_back(v); });
+  EXPECT_TRUE(std::equal(
+    values.begin(), values.end(), reference.begin(), reference.end()));
+  EXPECT_EQ(*snapshot.findMin(), *reference.begin());
+  for (int v = 0; v <= 2000; ++v) {
+    EXPECT_EQ(tree.find(v).has_value(), reference.count(v) == 1);
+  }
+}
+
+TEST(PersistentRBTreeTest, SnapshotsDoNotChange) {
+  PersistentRBTree<int> tree;
+  EXPECT_TRUE(tree.snapshot().empty());
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i);
+  }
+  auto before = tree.snapshot();
+  for (int i = 0; i < 100; i += 2) {
+    tree.remove(i);
+  }
+  tree.insert(1000);
+  auto after = tree.snapshot();
+
+  EXPECT_EQ(before.size(), 100);
+  EXPECT_NE(before.find(50), nullptr);
+  EXPECT_EQ(before.find(1000), nullptr);
+  EXPECT_EQ(after.size(), 51);
+  EXPECT_EQ(after.find(50), nullptr);
+  EXPECT_NE(after.find(1000), nullptr);
+  EXPECT_TRUE(before.checkRbTree().first);
+  EXPECT_TRUE(after.checkRbTree().first);
+
+  std::vector<int> seen;
+  before.for_each_in_range(10, 15, [&](int v) { seen.push_back(v); });
+  EXPECT_EQ(seen, (std::vector<int>{10, 11, 12, 13, 14}));
+  seen.clear();
+  after.for_each_in_range(10, 15, [&](int v) { seen.push_back(v); });
+  EXPECT_EQ(seen, (std::vector<int>{11, 13}));
+}
+
+// counts live instances, to see versions freed
+struct Counted {
+  static inline std::atomic<int> live = 0;
+  int key = 0;
+  Counted(int k = 0) : key(k) {
+    ++live;
+  }
+  Counted(const Counted& other) : key(other.key) {
+    ++live;
+  }
+  ~Counted() {
+    --live;
+  }
+  bool operator<(const Counted& other) const {
+    return key < other.key;
+  }
+};
+
+TEST(PersistentRBTreeTest, OldVersionsAreFreedWithTheLastSnapshot) {
+  {
+    PersistentRBTree<Counted> tree;
+    for (int i = 0; i < 1000; ++i) {
+      tree.insert(Counted(i));
+    }
+    EXPECT_EQ(Counted::live, 1000);
+    auto pinned = tree.snapshot();
+    for (int i = 0; i < 1000; i += 2) {
+      tree.remove(Counted(i));
+    }
+    // the pinned version keeps its path copies alive
+    EXPECT_GT(Counted::live, 1000);
+    EXPECT_EQ(pinned.size(), 1000);
+    pinned = {};
+    EXPECT_EQ(Counted::live, 500);
+  }
+  EXPECT_EQ(Counted::live, 0);
+}
+
+TEST(PersistentRBTreeTest, ReadersSeeWholeVersionsDuringWrites) {
+  PersistentRBTree<int> tree;
+  for (int i = 0; i < 2000; ++i) {
+    tree.insert(i * 2);
+  }
+  std::atomic<bool> done{false};
+  std::atomic<int> bad{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.emplace_back([&] {
+      while (!done.load(std::memory_order_relaxed)) {
+        auto snapshot = tree.snapshot();
+        // every version holds all the even keys
+        std::size_t even = 0;
+        std::size_t all = snapshot.for_each_in_range(
+          0, 4000, [&](int v) { even += v % 2 == 0; });
+        if (!snapshot.checkRbTree().first || even != 2000 ||
+            all != snapshot.size() || snapshot.find(1000) == nullptr) {
+          ++bad;
+        }
+      }
+    });
+  }
+  std::mt19937 gen(3);
+  for (int step = 0; step < 20000; ++step) {
+    int odd = static_cast<int>(gen() % 2000) * 2 + 1;
+    if (!tree.insert(odd)) {
+      tree.remove(odd);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(bad, 0);
+}
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,88 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-10-30
+ * @LastEditors: lize
+ */
+
+#include "poly_collection.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace lz {
+namespace test {
+using Taggedpointer::PolyCollection;
+using Taggedpointer::PolyHandle;
+
+struct Circle {
+  int id;
+  std::string Name() const {
+    return "circle";
+  }
+};
+struct Square {
+  int id;
+  std::string Name() const {
+    return "square";
+  }
+};
+using Shapes = PolyCollection<Circle, Square>;
+
+TEST(PolyCollectionTest, ForEachWalksTypeByType) {
+  Shapes shapes;
+  shapes.emplace<Square>(1);
+  shapes.emplace<Circle>(2);
+  shapes.emplace<Square>(3);
+  shapes.emplace<Circle>(4);
+  std::vector<int> ids;
+  shapes.for_each([&ids](auto ptr) { ids.push_back(ptr->id); });
+  EXPECT_EQ(ids, (std::vector<int>{2, 4, 1, 3}));
+  EXPECT_EQ(shapes.size(), 4);
+  EXPECT_EQ(shapes.count<Circle>(), 2);
+}
+
+TEST(PolyCollectionTest, GetDispatchesLikeTaggedPointer) {
+  Shapes shapes;
+  auto handle = shapes.emplace<Square>(7);
+  auto ptr = shapes.get(handle);
+  EXPECT_EQ(ptr.Index(), 1);
+  EXPECT_EQ(ptr.Dispatch([](auto p) { return p->Name(); }), "square");
+  EXPECT_EQ(ptr.Get<Square>()->id, 7);
+}
+
+TEST(PolyCollectionTest, HandlesSurviveSwapAndPop) {
+  Shapes shapes;
+  std::vector<PolyHandle> handles;
+  for (int i = 0; i < 100; ++i) {
+    handles.push_back(shapes.emplace<Circle>(i));
+  }
+  for (int i = 0; i < 100; i += 3) {
+    EXPECT_TRUE(shapes.erase(handles[i]));
+  }
+  for (int i = 0; i < 100; ++i) {
+    if (i % 3 == 0) {
+      EXPECT_FALSE(shapes.contains(handles[i]));
+    } else {
+      ASSERT_TRUE(shapes.contains(handles[i]));
+      EXPECT_EQ(shapes.get(handles[i]).Get<Circle>()->id, i);
+    }
+  }
+  EXPECT_EQ(shapes.count<Circle>(), 66);
+}
+
+TEST(PolyCollectionTest, StaleHandleAfterSlotReuse) {
+  Shapes shapes;
+  auto first = shapes.emplace<Circle>(1);
+  EXPECT_TRUE(shapes.erase(first));
+  EXPECT_FALSE(shapes.erase(first));
+  auto second = shapes.emplace<Circle>(2);
+  EXPECT_EQ(first.Slot(), second.Slot());
+  EXPECT_FALSE(shapes.contains(first));
+  EXPECT_TRUE(shapes.contains(second));
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,134 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-10
+ * @LastEditors: lize
+ */
+
+#include "utils/rbtree_snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace lz {
+namespace test {
+using rbtree::MappedSnapshot;
+using rbtree::SnapshotLayout;
+
+class RBTreeSnapshotTest : public ::testing::TestWithParam<SnapshotLayout> {
+ protected:
+  void TearDown() override {
+    std::filesystem::remove(_path);
+  }
+
+  std::filesystem::path _path =
+    std::filesystem::temp_directory_path() /
+    ("rbtree_snapshot_test_" +
+     std::to_string(static_cast<int>(GetParam())) + ".snap");
+};
+
+TEST_P(RBTreeSnapshotTest, QueriesMatchTheSavedTree) {
+  // sizes around full levels, where the Eytzinger walk changes shape
+  for (int n : {0, 1, 2, 3, 7, 8, 15, 16, 17, 100, 1023, 1024, 1025}) {
+    rbtree::RBTree<int> tree;
+    std::set<int> reference;
+    std::mt19937 gen(n);
+    while (static_cast<int>(reference.size()) < n) {
+      int v = static_cast<int>(gen() % (4 * n)) - n;
+      tree.insert(v);
+      reference.insert(v);
+    }
+    rbtree::saveSnapshot(tree, _path, GetParam());
+    MappedSnapshot<int> snapshot(_path);
+    ASSERT_EQ(snapshot.size(), reference.size()) << n;
+    EXPECT_EQ(snapshot.layout(), GetParam());
+
+    std::vector<int> all;
+    snapshot.for_each([&](int v) { all.push_back(v); });
+    EXPECT_TRUE(std::equal(
+      all.begin(), all.end(), reference.begin(), reference.end()))
+      << n;
+    if (n > 0) {
+      EXPECT_EQ(*snapshot.findMin(), *reference.begin());
+    } else {
+      EXPECT_EQ(snapshot.findMin(), nullptr);
+    }
+    for (int v = -n - 2; v < 3 * n + 2; ++v) {
+      const int* found = snapshot.find(v);
+      ASSERT_EQ(found != nullptr, reference.count(v) == 1) << n << " " << v;
+      if (found != nullptr) {
+        EXPECT_EQ(*found, v);
+      }
+      std::vector<int> seen;
+      snapshot.for_each_in_range(v, v + 5, [&](int x) { seen.push_back(x); });
+      std::vector<int> expected(reference.lower_bound(v),
+                                reference.lower_bound(v + 5));
+      ASSERT_EQ(seen, expected) << n << " " << v;
+    }
+
+    auto promoted = snapshot.toTree();
+    EXPECT_TRUE(promoted.checkRbTree().first);
+    EXPECT_EQ(promoted.size(), reference.size());
+    EXPECT_TRUE(std::equal(
+      promoted.begin(), promoted.end(), reference.begin(), reference.end()));
+    EXPECT_TRUE(promoted.insert(10 * n + 1));
+  }
+}
+
+TEST_P(RBTreeSnapshotTest, KeepsTheComparatorAndValueLayout) {
+  struct Point {
+    int32_t x;
+    int32_t y;
+  };
+  struct ByX {
+    bool operator()(const Point& a, const Point& b) const {
+      return a.x > b.x;  // descending
+    }
+  };
+  rbtree::RBTree<Point, ByX> tree;
+  for (int i = 0; i < 50; ++i) {
+    tree.insert(Point{i, -i});
+  }
+  rbtree::saveSnapshot(tree, _path, GetParam());
+  MappedSnapshot<Point, ByX> snapshot(_path);
+  EXPECT_EQ(snapshot.findMin()->x, 49);
+  ASSERT_NE(snapshot.find(Point{7, 0}), nullptr);
+  EXPECT_EQ(snapshot.find(Point{7, 0})->y, -7);
+  EXPECT_EQ(
+    snapshot.for_each_in_range(Point{10, 0}, Point{5, 0}, [](const Point&) {}),
+    5);
+  // the same bytes read as another type are refused
+  EXPECT_THROW(MappedSnapshot<int64_t>{_path}, std::runtime_error);
+  EXPECT_THROW(MappedSnapshot<int32_t>{_path}, std::runtime_error);
+}
+
+TEST_P(RBTreeSnapshotTest, RejectsDamagedFiles) {
+  std::vector<uint64_t> values{1, 2, 3, 4, 5};
+  rbtree::saveSnapshot(std::span<const uint64_t>(values), _path, GetParam());
+  EXPECT_EQ(MappedSnapshot<uint64_t>(_path).size(), 5);
+  // cut off the last value
+  std::filesystem::resize_file(_path, std::filesystem::file_size(_path) - 1);
+  EXPECT_THROW(MappedSnapshot<uint64_t>{_path}, std::runtime_error);
+  {
+    std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+    out << "not a snapshot, just some text that is long enough for a header"
+        << std::string(64, '.');
+  }
+  EXPECT_THROW(MappedSnapshot<uint64_t>{_path}, std::runtime_error);
+  std::filesystem::remove(_path);
+  EXPECT_THROW(MappedSnapshot<uint64_t>{_path}, std::runtime_error);
+}
+
+INSTANTIATE_TEST_SUITE_P(Layouts,
+                         RBTreeSnapshotTest,
+                         ::testing::Values(SnapshotLayout::Sorted,
+                                           SnapshotLayout::Eytzinger));
+}  // namespace test
+}  // namespace lz
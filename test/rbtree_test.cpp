@@ -0,0 +1,575 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-03
+ * @LastEditors: lize
+ */
+
+#include "utils/rbtree.h"
+#include "utils/shared_rbtree.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace lz {
+namespace test {
+using rbtree::RBTree;
+
+TEST(RBTreeTest, InsertFindRemove) {
+  RBTree<int> tree;
+  EXPECT_EQ(tree.findMin(), nullptr);
+  for (int v : {5, 3, 8, 1, 4, 7, 9}) {
+    EXPECT_TRUE(tree.insert(v));
+  }
+  EXPECT_FALSE(tree.insert(4));
+  EXPECT_EQ(tree.size(), 7);
+  ASSERT_NE(tree.find(4), nullptr);
+  EXPECT_EQ(*tree.find(4), 4);
+  EXPECT_EQ(tree.find(6), nullptr);
+  EXPECT_EQ(*tree.findMin(), 1);
+
+  EXPECT_TRUE(tree.remove(1));
+  EXPECT_FALSE(tree.remove(1));
+  EXPECT_EQ(*tree.findMin(), 3);
+  EXPECT_EQ(tree.size(), 6);
+  EXPECT_TRUE(tree.checkRbTree().first);
+}
+
+TEST(RBTreeTest, MatchesStdSetUnderRandomChurn) {
+  RBTree<int> tree;
+  std::set<int> reference;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> key(0, 2000);
+  for (int step = 0; step < 20000; ++step) {
+    int v = key(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.remove(v), reference.erase(v) == 1);
+    } else {
+      EXPECT_EQ(tree.insert(v), reference.insert(v).second);
+    }
+    if (step % 1000 == 0) {
+      ASSERT_TRUE(tree.checkRbTree().first);
+    }
+  }
+  EXPECT_TRUE(tree.checkRbTree().first);
+  EXPECT_EQ(tree.size(), reference.size());
+  for (int v = 0; v <= 2000; ++v) {
+    EXPECT_EQ(tree.find(v) != nullptr, reference.count(v) == 1);
+  }
+  EXPECT_EQ(*tree.findMin(), *reference.begin());
+}
+
+TEST(RBTreeTest, NodesArePackedAndReused) {
+  static_assert(sizeof(rbtree::ArenaNode<int>) == 16);
+  RBTree<std::string> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(std::to_string(i));
+  }
+  auto bytes = tree.bytes();
+  for (int i = 0; i < 100; ++i) {
+    tree.remove(std::to_string(i));
+    tree.insert(std::to_string(i + 100));
+  }
+  EXPECT_EQ(tree.bytes(), bytes);
+  EXPECT_EQ(*tree.findMin(), "100");
+}
+
+TEST(RBTreeTest, FromSortedBuildsValidTrees) {
+  for (int n : {0, 1, 2, 3, 7, 8, 100, 1023, 1024, 1025}) {
+    std::vector<int> values(n);
+    for (int i = 0; i < n; ++i) {
+      values[i] = i * 2;
+    }
+    auto tree = RBTree<int>::fromSorted(values);
+    ASSERT_TRUE(tree.checkRbTree().first) << n;
+    EXPECT_EQ(tree.size(), n);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_NE(tree.find(i * 2), nullptr);
+      EXPECT_EQ(tree.find(i * 2 + 1), nullptr);
+    }
+    // still an ordinary tree afterwards
+    EXPECT_TRUE(tree.insert(-1));
+    EXPECT_TRUE(tree.remove(-1));
+    EXPECT_TRUE(tree.checkRbTree().first);
+  }
+  auto tree = RBTree<std::string>::fromSorted(
+    std::vector<std::string>{"a", "a", "b", "c", "c"});
+  EXPECT_EQ(tree.size(), 3);
+  EXPECT_TRUE(tree.checkRbTree().first);
+}
+
+TEST(RBTreeTest, InsertBatchMatchesStdSet) {
+  RBTree<int> tree;
+  std::set<int> reference;
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> key(0, 100000);
+  // an empty tree and large batches rebuild; small ones go in one by one
+  for (int size : {5000, 3000, 50, 1, 200, 0, 10000, 7}) {
+    std::vector<int> batch(size);
+    for (int& v : batch) {
+      v = key(gen);
+    }
+    std::size_t before = reference.size();
+    reference.insert(batch.begin(), batch.end());
+    EXPECT_EQ(tree.insertBatch(batch), reference.size() - before);
+    ASSERT_TRUE(tree.checkRbTree().first) << size;
+    EXPECT_EQ(tree.size(), reference.size());
+  }
+  for (int v : reference) {
+    EXPECT_NE(tree.find(v), nullptr);
+  }
+  EXPECT_EQ(*tree.findMin(), *reference.begin());
+}
+
+TEST(RBTreeTest, IteratorsWalkInOrder) {
+  RBTree<int> tree;
+  EXPECT_EQ(tree.begin(), tree.end());
+  std::set<int> reference;
+  std::mt19937 gen(5);
+  for (int i = 0; i < 3000; ++i) {
+    int v = gen() % 10000;
+    tree.insert(v);
+    reference.insert(v);
+  }
+  static_assert(std::bidirectional_iterator<RBTree<int>::const_iterator>);
+  EXPECT_TRUE(std::equal(
+    tree.begin(), tree.end(), reference.begin(), reference.end()));
+  EXPECT_TRUE(std::equal(std::make_reverse_iterator(tree.end()),
+                         std::make_reverse_iterator(tree.begin()),
+                         reference.rbegin(),
+                         reference.rend()));
+}
+
+TEST(RBTreeTest, RangeQueriesMatchStdSet) {
+  RBTree<int> tree;
+  std::set<int> reference;
+  for (int i = 0; i < 500; ++i) {
+    tree.insert(i * 3);
+    reference.insert(i * 3);
+  }
+  for (int v = -2; v < 1505; ++v) {
+    auto lower = tree.lower_bound(v);
+    auto upper = tree.upper_bound(v);
+    auto expectLower = reference.lower_bound(v);
+    auto expectUpper = reference.upper_bound(v);
+    ASSERT_EQ(lower == tree.end(), expectLower == reference.end()) << v;
+    ASSERT_EQ(upper == tree.end(), expectUpper == reference.end()) << v;
+    if (lower != tree.end()) {
+      EXPECT_EQ(*lower, *expectLower);
+    }
+    if (upper != tree.end()) {
+      EXPECT_EQ(*upper, *expectUpper);
+    }
+    auto [first, last] = tree.equal_range(v);
+    EXPECT_EQ(std::distance(first, last), reference.count(v));
+  }
+
+  std::vector<int> seen;
+  EXPECT_EQ(tree.for_each_in_range(10, 40, [&](int v) { seen.push_back(v); }),
+            10);
+  EXPECT_EQ(seen, (std::vector<int>{12, 15, 18, 21, 24, 27, 30, 33, 36, 39}));
+  EXPECT_EQ(tree.for_each_in_range(40, 10, [](int) {}), 0);
+  EXPECT_EQ(tree.for_each_in_range(-100, 100000, [](int) {}), 500);
+}
+
+TEST(RBTreeTest, RankAndSelectFollowChurn) {
+  static_assert(sizeof(rbtree::ArenaNode<int, true>) == 20);
+  using Ranked = RBTree<int, std::less<int>, rbtree::ReadMode::Locked, true>;
+  auto tree = Ranked::fromSorted(std::vector<int>{0, 10, 20, 30});
+  EXPECT_EQ(*tree.select(2), 20);
+  EXPECT_EQ(tree.select(4), nullptr);
+  std::set<int> reference{0, 10, 20, 30};
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> key(0, 3000);
+  for (int step = 0; step < 20000; ++step) {
+    int v = key(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(tree.remove(v), reference.erase(v) == 1);
+    } else if (step % 500 == 0) {
+      std::vector<int> batch{v, v + 1, v + 7};
+      tree.insertBatch(batch);
+      reference.insert(batch.begin(), batch.end());
+    } else {
+      EXPECT_EQ(tree.insert(v), reference.insert(v).second);
+    }
+    if (step % 1000 == 0) {
+      ASSERT_TRUE(tree.checkRbTree().first) << step;
+      std::vector<int> sorted(reference.begin(), reference.end());
+      for (std::size_t k = 0; k < sorted.size(); k += 37) {
+        ASSERT_EQ(*tree.select(k), sorted[k]);
+      }
+      for (int probe = -1; probe < 3010; probe += 13) {
+        ASSERT_EQ(tree.rank(probe),
+                  std::lower_bound(sorted.begin(), sorted.end(), probe) -
+                    sorted.begin());
+      }
+    }
+  }
+  EXPECT_TRUE(tree.checkRbTree().first);
+  // p99 of 0..999 without sorting anything
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  std::shuffle(values.begin(), values.end(), gen);
+  Ranked percent;
+  for (int v : values) {
+    percent.insert(v);
+  }
+  EXPECT_EQ(*percent.select(99 * (percent.size() - 1) / 100), 989);
+}
+
+TEST(RBTreeTest, ComparatorOrdersBothTrees) {
+  RBTree<int, std::greater<int>> tree;
+  rbtree::SharedRBTree<int, std::greater<int>> shared;
+  for (int v : {5, 3, 8, 1, 4, 7, 9}) {
+    tree.insert(v);
+    shared.insert(v);
+  }
+  EXPECT_EQ(std::vector<int>(tree.begin(), tree.end()),
+            (std::vector<int>{9, 8, 7, 5, 4, 3, 1}));
+  EXPECT_EQ(*tree.findMin(), 9);
+  EXPECT_EQ(shared.findMin()->_value, 9);
+  EXPECT_NE(shared.find(4), nullptr);
+  shared.remove(4);
+  EXPECT_EQ(shared.find(4), nullptr);
+  EXPECT_TRUE(tree.checkRbTree().first);
+  EXPECT_TRUE(shared.checkRbTree().first);
+}
+
+TEST(RBTreeTest, MapEmplacesAndLooksUpByStringView) {
+  // std::string has no implicit constructor from string_view, so these
+  // lookups only compile because std::less<> is transparent
+  rbtree::RBMap<std::string, int, std::less<>> words;
+  for (std::string_view word : {"b", "a", "c", "a", "b", "a"}) {
+    words.try_emplace(std::string(word), 0).first->second += 1;
+  }
+  EXPECT_EQ(words.size(), 3);
+  ASSERT_NE(words.find(std::string_view("a")), nullptr);
+  EXPECT_EQ(words.find(std::string_view("a"))->second, 3);
+  EXPECT_EQ(words.find(std::string_view("d")), nullptr);
+  EXPECT_TRUE(words.contains(std::string_view("c")));
+
+  auto [entry, inserted] = words.emplace("b", 100);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(entry->second, 2);
+  std::tie(entry, inserted) = words.emplace("d", 4);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(entry->first, "d");
+
+  std::vector<std::string> keys;
+  words.for_each_in_range(
+    std::string_view("b"), std::string_view("d"), [&](const auto& word) {
+      keys.push_back(word.first);
+    });
+  EXPECT_EQ(keys, (std::vector<std::string>{"b", "c"}));
+  EXPECT_EQ(words.lower_bound(std::string_view("bb"))->first, "c");
+  EXPECT_TRUE(words.remove(std::string_view("a")));
+  EXPECT_FALSE(words.remove(std::string_view("a")));
+  EXPECT_TRUE(words.checkRbTree().first);
+
+  using Ids = rbtree::RBMap<int, std::string>;
+  auto ids = Ids::fromSorted(std::vector<std::pair<const int, std::string>>{
+    {1, "one"}, {2, "two"}, {3, "three"}});
+  EXPECT_EQ(ids.find(2)->second, "two");
+  EXPECT_TRUE(ids.checkRbTree().first);
+}
+
+TEST(RBTreeTest, ExtractedNodesGoBackWithoutAllocating) {
+  RBTree<std::string> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(std::to_string(i));
+  }
+  auto bytes = tree.bytes();
+  const std::string* stored = tree.find("42");
+
+  auto node = tree.extract("42");
+  ASSERT_FALSE(node.empty());
+  EXPECT_EQ(&node.value(), stored);
+  EXPECT_EQ(tree.size(), 99);
+  EXPECT_EQ(tree.find("42"), nullptr);
+  EXPECT_TRUE(tree.extract("42").empty());
+  node.value() = "420";
+  EXPECT_TRUE(tree.insert(std::move(node)));
+  EXPECT_TRUE(node.empty());
+  // same slot, same string buffer
+  EXPECT_EQ(tree.find("420"), stored);
+  EXPECT_EQ(tree.size(), 100);
+  EXPECT_TRUE(tree.checkRbTree().first);
+
+  // a clash leaves the node in the handle, and dropping it frees the node
+  node = tree.extract("7");
+  node.value() = "8";
+  EXPECT_FALSE(tree.insert(std::move(node)));
+  EXPECT_FALSE(node.empty());
+  node = {};
+  EXPECT_EQ(tree.size(), 99);
+  tree.insert("7");
+  EXPECT_EQ(tree.bytes(), bytes);
+
+  RBTree<std::string> other;
+  EXPECT_TRUE(other.insert(tree.extract("9")));
+  EXPECT_NE(other.find("9"), nullptr);
+  EXPECT_EQ(tree.find("9"), nullptr);
+
+  rbtree::RBMap<int, std::string> map;
+  map.try_emplace(1, "one");
+  auto entry = map.extract(1);
+  EXPECT_EQ(entry.key(), 1);
+  entry.setKey(2);
+  entry.mapped() += "!";
+  EXPECT_TRUE(map.insert(std::move(entry)));
+  EXPECT_EQ(map.find(2)->second, "one!");
+  EXPECT_EQ(map.find(1), nullptr);
+}
+
+TEST(RBTreeTest, SetOperationsMatchStdAlgorithms) {
+  using Ranked = RBTree<int, std::less<int>, rbtree::ReadMode::Locked, true>;
+  enum class Op { Union, Intersection, Difference };
+  // sizes from empty to lopsided; 4 threads fork only on the large ones
+  for (int n : {0, 1, 40, 5000, 30000}) {
+    for (int m : {0, 1, 300, 30000}) {
+      for (Op op : {Op::Union, Op::Intersection, Op::Difference}) {
+        for (unsigned threads : {1U, 4U}) {
+          std::mt19937 gen(n * 31 + m);
+          std::set<int> a;
+          std::set<int> b;
+          Ranked tree;
+          Ranked other;
+          while (static_cast<int>(a.size()) < n) {
+            int v = static_cast<int>(gen() % (3 * (n + m) + 1));
+            a.insert(v);
+            tree.insert(v);
+          }
+          while (static_cast<int>(b.size()) < m) {
+            int v = static_cast<int>(gen() % (3 * (n + m) + 1));
+            b.insert(v);
+            other.insert(v);
+          }
+          std::vector<int> expected;
+          std::size_t changed;
+          if (op == Op::Union) {
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                           std::back_inserter(expected));
+            changed = tree.unionWith(other, threads);
+          } else if (op == Op::Intersection) {
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                                  std::back_inserter(expected));
+            changed = tree.intersectWith(other, threads);
+          } else {
+            std::set_difference(a.begin(), a.end(), b.begin(), b.end(),
+                                std::back_inserter(expected));
+            changed = tree.differenceWith(other, threads);
+          }
+          SCOPED_TRACE(testing::Message() << n << " " << m << " "
+                                          << static_cast<int>(op) << " "
+                                          << threads);
+          ASSERT_TRUE(tree.checkRbTree().first);
+          ASSERT_EQ(tree.size(), expected.size());
+          EXPECT_EQ(changed,
+                    op == Op::Union ? expected.size() - a.size()
+                                    : a.size() - expected.size());
+          EXPECT_TRUE(std::equal(
+            tree.begin(), tree.end(), expected.begin(), expected.end()));
+          for (std::size_t k = 0; k < expected.size(); k += 101) {
+            ASSERT_EQ(*tree.select(k), expected[k]);
+          }
+          // other is untouched, and dropped nodes are reused
+          EXPECT_EQ(other.size(), b.size());
+          EXPECT_TRUE(tree.insert(-1));
+        }
+      }
+    }
+  }
+  // with itself
+  auto tree = RBTree<int>::fromSorted(std::vector<int>{1, 2, 3});
+  EXPECT_EQ(tree.unionWith(tree), 0);
+  EXPECT_EQ(tree.intersectWith(tree), 0);
+  EXPECT_EQ(tree.size(), 3);
+  EXPECT_EQ(tree.differenceWith(tree), 3);
+  EXPECT_TRUE(tree.empty());
+}
+
+TEST(RBTreeTest, SplitAndJoinKeepTheTreeValid) {
+  using Ranked = RBTree<int, std::less<int>, rbtree::ReadMode::Locked, true>;
+  for (int n : {0, 1, 2, 10, 1000}) {
+    std::mt19937 gen(n);
+    for (int cut = -1; cut <= 2 * n + 1; cut += std::max(1, n / 7)) {
+      Ranked tree;
+      for (int v = 0; v < n; ++v) {
+        tree.insert(2 * v);  // inserted in order: a lopsided tree to cut
+      }
+      Ranked right = tree.split(cut);
+      SCOPED_TRACE(testing::Message() << n << " " << cut);
+      ASSERT_TRUE(tree.checkRbTree().first);
+      ASSERT_TRUE(right.checkRbTree().first);
+      int below = std::clamp((cut + 1) / 2, 0, n);
+      ASSERT_EQ(tree.size(), below);
+      ASSERT_EQ(right.size(), n - below);
+      if (below > 0) {
+        EXPECT_LT(*std::prev(tree.end()), cut);
+      }
+      if (below < n) {
+        EXPECT_GE(*right.findMin(), cut);
+      }
+      // and back together around a key between the halves
+      if (cut % 2 != 0 || cut > 2 * n - 2 || cut < 0) {
+        continue;
+      }
+      Ranked rest = right.split(cut + 1);
+      EXPECT_EQ(*right.findMin(), cut);
+      right.remove(cut);
+      Ranked joined;
+      joined.join(-5, tree);  // joined was empty, so any key is in order
+      joined.remove(-5);
+      joined.join(cut, rest);
+      ASSERT_TRUE(joined.checkRbTree().first);
+      EXPECT_TRUE(tree.empty());
+      EXPECT_TRUE(rest.empty());
+      ASSERT_EQ(joined.size(), n);
+      std::size_t k = 0;
+      for (int v : joined) {
+        ASSERT_EQ(v, 2 * static_cast<int>(k));
+        ASSERT_EQ(*joined.select(k++), v);
+      }
+    }
+  }
+  // keys out of order are refused, and nothing moves
+  auto left = RBTree<int>::fromSorted(std::vector<int>{1, 2, 3});
+  auto right = RBTree<int>::fromSorted(std::vector<int>{7, 8});
+  EXPECT_THROW(left.join(3, right), std::invalid_argument);
+  EXPECT_THROW(left.join(7, right), std::invalid_argument);
+  EXPECT_THROW(left.join(5, left), std::invalid_argument);
+  EXPECT_EQ(left.size(), 3);
+  EXPECT_EQ(right.size(), 2);
+  left.join(5, right);
+  EXPECT_EQ(left.size(), 6);
+  EXPECT_TRUE(right.empty());
+  EXPECT_TRUE(left.checkRbTree().first);
+}
+
+TEST(RBTreeTest, FindBatchMatchesFind) {
+  RBTree<int> tree;
+  RBTree<int, std::less<int>, rbtree::ReadMode::Optimistic> optimistic;
+  std::mt19937 gen(21);
+  for (int i = 0; i < 5000; ++i) {
+    int v = static_cast<int>(gen() % 20000);
+    tree.insert(v);
+    optimistic.insert(v);
+  }
+  // fewer keys than lanes, exactly as many, and lanes refilled many times
+  for (std::size_t n : {0, 1, 15, 16, 17, 3000}) {
+    std::vector<int> keys(n);
+    for (int& key : keys) {
+      key = static_cast<int>(gen() % 20010) - 5;
+    }
+    std::vector<const int*> out(n);
+    std::vector<std::optional<int>> copies(n);
+    std::size_t found = tree.findBatch(keys, out);
+    EXPECT_EQ(optimistic.findBatch(keys, copies), found);
+    std::size_t expected = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(out[i], tree.find(keys[i])) << n << " " << i;
+      ASSERT_EQ(copies[i], optimistic.find(keys[i])) << n << " " << i;
+      expected += out[i] != nullptr;
+    }
+    EXPECT_EQ(found, expected);
+  }
+  std::vector<const int*> small(1);
+  EXPECT_THROW(tree.findBatch(std::vector<int>{1, 2}, small),
+               std::invalid_argument);
+
+  // a map, looked up by string_view
+  rbtree::RBMap<std::string, int, std::less<>> map;
+  map.emplace("one", 1);
+  map.emplace("two", 2);
+  std::vector<std::string_view> names{"two", "three", "one"};
+  std::vector<rbtree::RBMap<std::string, int, std::less<>>::Found> entries(3);
+  EXPECT_EQ(map.findBatch<std::string_view>(names, entries), 2);
+  EXPECT_EQ(entries[0]->second, 2);
+  EXPECT_EQ(entries[1], nullptr);
+  EXPECT_EQ(entries[2]->second, 1);
+}
+
+// two ints need 8-byte alignment for atomic_ref but only have 4, so the
+// node lines the value up instead of leaving it after the 12 link bytes
+struct IntPair {
+  int first;
+  int second;
+  bool operator<(const IntPair& other) const {
+    return first < other.first;
+  }
+};
+
+TEST(RBTreeTest, OptimisticValuesAreAtomicRefAligned) {
+  using Tree =
+    RBTree<IntPair, std::less<IntPair>, rbtree::ReadMode::Optimistic>;
+  constexpr auto kAlign = std::atomic_ref<IntPair>::required_alignment;
+  static_assert(alignof(Tree::Node) % kAlign == 0);
+  static_assert(offsetof(Tree::Node, _value) % kAlign == 0);
+  static_assert(sizeof(rbtree::ArenaNode<IntPair>) == 20);
+  Tree tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(IntPair{i, -i});
+  }
+  auto found = tree.find(IntPair{42, 0});
+  ASSERT_TRUE(found.has_value());
+  EXPECT_EQ(found->second, -42);
+  EXPECT_TRUE(tree.checkRbTree().first);
+}
+
+TEST(RBTreeTest, OptimisticReadersSeeStableKeysDuringWrites) {
+  using Tree = RBTree<int, std::less<int>, rbtree::ReadMode::Optimistic>;
+  Tree tree;
+  // odd keys stay put; the writer churns the even keys around them, which
+  // rotates and recolors the nodes the readers walk through
+  for (int v = 1; v < 4000; v += 2) {
+    tree.insert(v);
+  }
+  std::atomic<bool> done{false};
+  std::atomic<int> misses{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      while (!done.load(std::memory_order_relaxed)) {
+        int odd = static_cast<int>(gen() % 2000) * 2 + 1;
+        auto found = tree.find(odd);
+        if (!found || *found != odd || tree.find(-odd).has_value()) {
+          misses.fetch_add(1);
+        }
+        auto min = tree.findMin();
+        if (!min || *min > 1) {
+          misses.fetch_add(1);
+        }
+      }
+    });
+  }
+  std::mt19937 gen(99);
+  for (int step = 0; step < 50000; ++step) {
+    int even = static_cast<int>(gen() % 2000) * 2;
+    if (!tree.insert(even)) {
+      tree.remove(even);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(misses.load(), 0);
+  EXPECT_TRUE(tree.checkRbTree().first);
+}
+
+}  // namespace test
+}  // namespace lz
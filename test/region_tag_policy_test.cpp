@@ -0,0 +1,74 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-10-31
+ * @LastEditors: lize
+ */
+
+#include "region_tag_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "unique_taggedpointer.h"
+
+namespace lz {
+namespace test {
+using Taggedpointer::RegionTagPolicy;
+using Taggedpointer::TaggedPointer;
+using Taggedpointer::UniqueTaggedPointer;
+
+struct Leaf {
+  int Kind() const {
+    return 0;
+  }
+};
+struct Inner {
+  int Kind() const {
+    return 1;
+  }
+  double weight = 0.5;
+};
+struct Root {
+  int Kind() const {
+    return 2;
+  }
+};
+// 16MiB per type keeps the reservation small
+using Node = TaggedPointer<RegionTagPolicy<24>, Leaf, Inner, Root>;
+using OwnedNode = UniqueTaggedPointer<Node>;
+
+TEST(RegionTagPolicyTest, TypeComesFromAddress) {
+  EXPECT_EQ(Node::kTypeCount, 3);
+  std::vector<OwnedNode> nodes;
+  for (int i = 0; i < 1000; ++i) {
+    nodes.push_back(OwnedNode::Make<Leaf>());
+    nodes.push_back(OwnedNode::Make<Inner>());
+    nodes.push_back(OwnedNode::Make<Root>());
+  }
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    Node node = nodes[i].get();
+    EXPECT_EQ(node.Index(), i % 3);
+    EXPECT_EQ(node.Dispatch([](auto ptr) { return ptr->Kind(); }), i % 3);
+  }
+}
+
+TEST(RegionTagPolicyTest, StoredPointerIsUntouched) {
+  auto inner = OwnedNode::Make<Inner>();
+  Node node = inner.get();
+  Inner* raw = node.Get<Inner>();
+  ASSERT_NE(raw, nullptr);
+  EXPECT_EQ(node.Raw(), reinterpret_cast<uint64_t>(raw));
+  EXPECT_EQ(raw->weight, 0.5);
+  EXPECT_EQ(node.Get<Leaf>(), nullptr);
+}
+
+TEST(RegionTagPolicyTest, NullHandle) {
+  Node node;
+  EXPECT_FALSE(node);
+  EXPECT_EQ(node.Index(), 0);
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,195 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-10-26
+ * @LastEditors: lize
+ */
+
+#include "taggedpointer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lz {
+namespace test {
+using Taggedpointer::TaggedPointer;
+
+template <std::size_t I>
+struct Kind {
+  std::size_t Id() const {
+    return I;
+  }
+};
+
+template <typename Seq>
+struct KindList;
+template <std::size_t... Is>
+struct KindList<std::index_sequence<Is...>> {
+  using Pointer = TaggedPointer<Kind<Is>...>;
+  using Objects = std::tuple<Kind<Is>...>;
+  static std::vector<Pointer> Pool(Objects& objects) {
+    return {Pointer(&std::get<Is>(objects))...};
+  }
+};
+
+struct Guitar {
+  std::string name = "guitar";
+};
+struct Drum {
+  std::string name = "drum";
+};
+
+TEST(TaggedPointerTest, DispatchRecoversTypeAndAddress) {
+  Guitar guitar;
+  Drum drum;
+  TaggedPointer<Guitar, Drum> a = &guitar;
+  TaggedPointer<Guitar, Drum> b = &drum;
+  EXPECT_EQ(a.Index(), 0);
+  EXPECT_EQ(b.Index(), 1);
+  a.Dispatch([&](auto ptr) { EXPECT_EQ((void*)ptr, (void*)&guitar); });
+  b.Dispatch([&](auto ptr) { EXPECT_EQ((void*)ptr, (void*)&drum); });
+}
+
+TEST(TaggedPointerTest, DispatchReturnsValue) {
+  Drum drum;
+  TaggedPointer<Guitar, Drum> tp = &drum;
+  std::string name = tp.Dispatch([](auto ptr) { return ptr->name; });
+  EXPECT_EQ(name, "drum");
+}
+
+TEST(TaggedPointerTest, VisitDeducesCommonType) {
+  Guitar guitar;
+  Drum drum;
+  auto size = [](auto ptr) {
+    if constexpr (std::is_same_v<decltype(ptr), Guitar*>) {
+      return 6;
+    } else {
+      return 0.5;
+    }
+  };
+  const TaggedPointer<Guitar, Drum> a = &guitar;
+  const TaggedPointer<Guitar, Drum> b = &drum;
+  static_assert(std::is_same_v<decltype(a.Visit(size)), double>);
+  EXPECT_EQ(a.Visit(size), 6.0);
+  EXPECT_EQ(b.Visit(size), 0.5);
+}
+
+TEST(TaggedPointerTest, VisitPairHitsEveryCell) {
+  using Left = KindList<std::make_index_sequence<3>>;
+  using Right = KindList<std::make_index_sequence<18>>;
+  Left::Objects leftObjects;
+  Right::Objects rightObjects;
+  auto lefts = Left::Pool(leftObjects);
+  auto rights = Right::Pool(rightObjects);
+  auto cell = [](auto x, auto y) { return x->Id() * 100 + y->Id(); };
+  for (auto& left : lefts) {
+    for (auto& right : rights) {
+      EXPECT_EQ(Taggedpointer::Visit(cell, left, right),
+                left.Index() * 100 + right.Index());
+    }
+  }
+
+  Guitar guitar;
+  TaggedPointer<Guitar, Drum> instrument = &guitar;
+  auto mixed = [](auto x, auto) -> int {
+    return std::is_same_v<decltype(x), Guitar*> ? 1 : 2;
+  };
+  EXPECT_EQ(Taggedpointer::Visit(mixed, instrument, lefts[2]), 1);
+}
+
+template <std::size_t N>
+void checkEveryIndex() {
+  using List = KindList<std::make_index_sequence<N>>;
+  typename List::Objects objects;
+  auto pool = List::Pool(objects);
+  for (std::size_t i = 0; i < N; ++i) {
+    EXPECT_EQ(pool[i].Index(), i);
+    EXPECT_EQ(pool[i].Dispatch([](auto ptr) { return ptr->Id(); }), i);
+    std::size_t folded = N;
+    pool[i].DispatchFold([&folded](auto ptr) { folded = ptr->Id(); });
+    EXPECT_EQ(folded, i);
+  }
+}
+
+TEST(TaggedPointerTest, DispatchEveryIndex) {
+  checkEveryIndex<2>();
+  checkEveryIndex<7>();
+  checkEveryIndex<16>();
+  checkEveryIndex<17>();
+  checkEveryIndex<64>();
+}
+
+TEST(TaggedPointerTest, LayoutUsesHighBitsFirst) {
+  using Layout = Taggedpointer::TagLayout<Kind<0>, Kind<1>, Kind<2>>;
+  EXPECT_EQ(Layout::kTagBits, 2);
+  EXPECT_EQ(Layout::kLowTagBits, 0);
+  Kind<2> kind;
+  auto bits = Layout::Encode(2, &kind);
+  EXPECT_EQ(Layout::Index(bits), 2);
+  EXPECT_EQ(Layout::Pointer(bits), reinterpret_cast<uint64_t>(&kind));
+}
+
+template <std::size_t I>
+struct alignas(8) Wide {
+  uint64_t value = I;
+};
+
+template <typename Seq>
+struct WideLayout;
+template <std::size_t... Is>
+struct WideLayout<std::index_sequence<Is...>> {
+  // 5-level paging leaves 7 high bits; pretend only 2 to force the spill
+  using type = Taggedpointer::BasicTagLayout<2, Wide<Is>...>;
+};
+
+TEST(TaggedPointerTest, LayoutSpillsIntoAlignmentBits) {
+  using Layout = WideLayout<std::make_index_sequence<20>>::type;
+  EXPECT_EQ(Layout::kTagBits, 5);
+  EXPECT_EQ(Layout::kHighTagBits, 2);
+  EXPECT_EQ(Layout::kLowTagBits, 3);
+  Wide<0> wide;
+  for (std::size_t i = 0; i < 20; ++i) {
+    auto bits = Layout::Encode(i, &wide);
+    EXPECT_EQ(Layout::Index(bits), i);
+    EXPECT_EQ(Layout::Pointer(bits), reinterpret_cast<uint64_t>(&wide));
+  }
+}
+
+TEST(TaggedPointerTest, PayloadSitsBesideTheTag) {
+  using Pointer = TaggedPointer<Taggedpointer::Payload<8>, Guitar, Drum>;
+  static_assert(sizeof(Pointer) == sizeof(uint64_t));
+  static_assert(Pointer::Layout::kSpareBits == 16 - 1 - 8);
+  Guitar guitar;
+  Drum drum;
+  Pointer tp(&drum, 0xA5);
+  EXPECT_EQ(tp.payload(), 0xA5);
+  EXPECT_EQ(tp.Index(), 1);
+  EXPECT_EQ(tp.Get<Drum>(), &drum);
+  EXPECT_EQ(tp.Dispatch([](auto ptr) { return ptr->name; }), "drum");
+
+  tp.set_payload(0xFF);
+  EXPECT_EQ(tp.payload(), 0xFF);
+  EXPECT_EQ(tp.Get<Drum>(), &drum);
+  EXPECT_NE(tp, Pointer(&drum, 0x01));
+
+  tp = Pointer(&guitar);
+  EXPECT_EQ(tp.payload(), 0);
+  EXPECT_EQ(tp.Get<Guitar>(), &guitar);
+}
+
+TEST(TaggedPointerTest, OptionsInAnyOrder) {
+  using Bits = Taggedpointer::BitTagPolicy;
+  using Payload = Taggedpointer::Payload<4>;
+  using A = TaggedPointer<Bits, Payload, Guitar, Drum>;
+  using B = TaggedPointer<Payload, Bits, Guitar, Drum>;
+  static_assert(std::is_same_v<A::Layout, B::Layout>);
+  static_assert(A::kPayloadBits == 4 && A::kTypeCount == 2);
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,162 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-14
+ * @LastEditors: lize
+ */
+
+#include "utils/time.h"
+
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lz {
+namespace test {
+
+TEST(TscClockTest, IsAChronoClock) {
+  static_assert(std::chrono::is_clock_v<TscClock>);
+  static_assert(TscClock::is_steady);
+  auto a = TscClock::now();
+  auto b = TscClock::now();
+  EXPECT_LE(a, b);
+  std::chrono::nanoseconds span = b - a;
+  EXPECT_GE(span.count(), 0);
+}
+
+TEST(TscClockTest, KeepsPaceWithMonotonicRaw) {
+  TscClock::calibrate();
+  if (!TscClock::invariant()) {
+    GTEST_SKIP() << "no invariant TSC";
+  }
+  EXPECT_GT(TscClock::ticksPerSecond(), 100'000'000U);
+  // the same epoch as CLOCK_MONOTONIC_RAW
+  uint64_t before = monotonicRawNs();
+  int64_t now = TscClock::now().time_since_epoch().count();
+  uint64_t after = monotonicRawNs();
+  EXPECT_GE(now + 1000, static_cast<int64_t>(before));
+  EXPECT_LE(now, static_cast<int64_t>(after) + 1000);
+
+  // and the same rate, to 0.1% over 50 ms
+  uint64_t rawStart = monotonicRawNs();
+  auto tscStart = TscClock::now();
+  uint64_t ticksStart = rdtsc();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  uint64_t raw = monotonicRawNs() - rawStart;
+  int64_t tsc = (TscClock::now() - tscStart).count();
+  int64_t ticks = TscClock::toNs(rdtsc() - ticksStart);
+  EXPECT_NEAR(tsc, raw, raw / 1000);
+  EXPECT_NEAR(ticks, raw, raw / 1000);
+  // ns to ticks and back
+  EXPECT_NEAR(TscClock::toNs(TscClock::toTicks(1'000'000'000)),
+              1'000'000'000,
+              10);
+
+  auto wall = TscClock::to_sys(TscClock::now());
+  auto sys = std::chrono::system_clock::now();
+  EXPECT_LT(std::chrono::abs(sys - wall), std::chrono::milliseconds(5));
+}
+
+// every record as "HH:MM:SS uuuuuu\n", parsed one at a time and as a batch
+static void expectRoundTrips(const std::vector<uint64_t>& times) {
+  std::string buffer(times.size() * 16, '\n');
+  for (std::size_t i = 0; i < times.size(); ++i) {
+    EXPECT_EQ(formatTimeNs(times[i], &buffer[i * 16]), &buffer[i * 16 + 15]);
+  }
+  std::vector<uint64_t> parsed(times.size());
+  ASSERT_EQ(parseTimesNs(buffer, 16, parsed), times.size());
+  for (std::size_t i = 0; i < times.size(); ++i) {
+    ASSERT_EQ(parsed[i], times[i]) << buffer.substr(i * 16, 15);
+    ASSERT_EQ(parseTimeNs(std::string_view(buffer).substr(i * 16, 15)),
+              times[i]);
+  }
+}
+
+TEST(TimeParseTest, EveryTimeOfDayRoundTrips) {
+  constexpr uint64_t kSecond = 1'000'000'000;
+  std::vector<uint64_t> times;
+  for (uint64_t s = 0; s < 86400; ++s) {
+    for (uint64_t micros : {uint64_t{0}, (s * 7919 + 13) % 1'000'000,
+                            uint64_t{999'999}}) {
+      times.push_back(s * kSecond + micros * 1000);
+    }
+  }
+  expectRoundTrips(times);
+  // and every microsecond, in the last second of the day
+  times.clear();
+  for (uint64_t micros = 0; micros < 1'000'000; ++micros) {
+    times.push_back(86399 * kSecond + micros * 1000);
+  }
+  expectRoundTrips(times);
+
+  char text[kTimeLength];
+  formatTimeNs(86400 * kSecond + 1999, text);  // wraps, cut to the us
+  EXPECT_EQ(std::string_view(text, kTimeLength), "00:00:00 000001");
+  EXPECT_EQ(timeToNanoseconds("12:34:56 123456"),
+            (12 * 3600 + 34 * 60 + 56) * kSecond + 123'456'000);
+  // the loose spellings it took before still go through the stream
+  EXPECT_EQ(timeToNanoseconds("1:2:3 4"), 3723 * kSecond + 4000);
+}
+
+TEST(TimeParseTest, RejectsEveryBadCharacter) {
+  auto valid = [](const std::string& text) {
+    auto field = [&](int at) {
+      return (text[at] - '0') * 10 + text[at + 1] - '0';
+    };
+    for (std::size_t i = 0; i < kTimeLength; ++i) {
+      bool separator = i == 2 || i == 5 || i == 8;
+      if (!separator && !std::isdigit(static_cast<unsigned char>(text[i]))) {
+        return false;
+      }
+    }
+    return text[2] == ':' && text[5] == ':' && text[8] == ' ' &&
+           field(0) < 24 && field(3) < 60 && field(6) < 60;
+  };
+  for (std::string base : {"23:59:59 999999", "09:05:00 000000"}) {
+    std::vector<std::string> texts;
+    for (std::size_t at = 0; at < kTimeLength; ++at) {
+      for (int c = 0; c < 256; ++c) {
+        std::string text = base;
+        text[at] = static_cast<char>(c);
+        texts.push_back(text);
+      }
+    }
+    // stride 17 with a byte between records; the last has none after it
+    std::string buffer;
+    for (auto& text : texts) {
+      buffer += text + "\t\n";
+    }
+    buffer.resize(buffer.size() - 2);
+    std::vector<uint64_t> parsed(texts.size());
+    std::size_t expected = 0;
+    for (auto& text : texts) {
+      expected += valid(text);
+    }
+    EXPECT_EQ(parseTimesNs(buffer, 17, parsed), expected);
+    for (std::size_t i = 0; i < texts.size(); ++i) {
+      bool ok = valid(texts[i]);
+      ASSERT_EQ(parsed[i] != kInvalidTime, ok) << texts[i];
+      ASSERT_EQ(parseTimeNs(texts[i]).has_value(), ok) << texts[i];
+      if (ok) {
+        ASSERT_EQ(parsed[i], *parseTimeNs(texts[i]));
+      }
+    }
+  }
+  EXPECT_FALSE(parseTimeNs("23:59:59 99999").has_value());
+  EXPECT_FALSE(parseTimeNs("23:59:59 9999999").has_value());
+  std::vector<uint64_t> one(1);
+  EXPECT_EQ(parseTimesNs("", 16, one), 0);
+  EXPECT_EQ(parseTimesNs("00:00:01 000000", 16, one), 1);  // no byte after
+  EXPECT_EQ(one[0], 1'000'000'000U);
+  EXPECT_THROW(parseTimesNs("00:00:01 000000", 14, one),
+               std::invalid_argument);
+  EXPECT_THROW(parseTimesNs(std::string(32, '0'), 16, std::span(one.data(), 0)),
+               std::invalid_argument);
+}
+
+}  // namespace test
+}  // namespace lz
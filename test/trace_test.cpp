@@ -0,0 +1,192 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-11-17
+ * @LastEditors: lize
+ */
+
+#ifndef LZ_TRACE
+#define LZ_TRACE
+#endif
+#include "utils/trace.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lz {
+namespace test {
+using trace::LatencyHistogram;
+
+TEST(LatencyHistogramTest, BucketsKeepOnePercent) {
+  for (uint64_t v : std::initializer_list<uint64_t>{
+         0, 1, 127, 128, 255, 256, 1000, 123456789, 1ULL << 40, UINT64_MAX}) {
+    std::size_t bucket = LatencyHistogram::bucket(v);
+    ASSERT_LT(bucket, LatencyHistogram::kBuckets) << v;
+    uint64_t highest = LatencyHistogram::highest(bucket);
+    EXPECT_GE(highest, v);
+    EXPECT_LE(highest - v, v / 128) << v;
+    if (v > 0) {
+      EXPECT_LE(LatencyHistogram::bucket(v - 1), bucket);
+    }
+  }
+  std::mt19937_64 gen(24);
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t v = gen() >> (gen() % 64);
+    uint64_t highest = LatencyHistogram::highest(LatencyHistogram::bucket(v));
+    ASSERT_GE(highest, v);
+    ASSERT_LE(highest - v, v / 128) << v;
+  }
+}
+
+TEST(LatencyHistogramTest, PercentilesMatchTheSortedValues) {
+  LatencyHistogram histogram;
+  std::vector<uint64_t> values;
+  std::mt19937 gen(7);
+  std::lognormal_distribution<double> latency(6, 1);  // ~400 ns, long tail
+  for (int i = 0; i < 100000; ++i) {
+    auto v = static_cast<uint64_t>(latency(gen));
+    values.push_back(v);
+    histogram.record(v);
+  }
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(histogram.count(), values.size());
+  EXPECT_EQ(histogram.min(), values.front());
+  EXPECT_EQ(histogram.max(), values.back());
+  for (double p : {0.0, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    auto rank = std::clamp<std::size_t>(p * values.size() + 0.5, 1,
+                                        values.size());
+    uint64_t exact = values[rank - 1];
+    uint64_t estimate = histogram.percentile(p);
+    EXPECT_GE(estimate, exact) << p;
+    EXPECT_LE(estimate - exact, exact / 128) << p;
+  }
+  LatencyHistogram twice;
+  twice.merge(histogram);
+  twice.merge(histogram);
+  EXPECT_EQ(twice.count(), 2 * values.size());
+  EXPECT_EQ(twice.percentile(0.5), histogram.percentile(0.5));
+}
+
+TEST(ThreadRingTest, DropsWhenFullInsteadOfWaiting) {
+  auto ring = std::make_unique<trace::ThreadRing>(0);
+  std::size_t n = trace::ThreadRing::kCapacity + 100;
+  for (uint32_t i = 0; i < n; ++i) {
+    ring->push({i, i + 1, i, 0});
+  }
+  EXPECT_EQ(ring->dropped(), 100);
+  uint32_t next = 0;
+  EXPECT_EQ(ring->drain([&](const trace::Record& record) {
+    EXPECT_EQ(record.probe, next++);
+  }),
+            trace::ThreadRing::kCapacity);
+  ring->push({1, 2, 3, 0});
+  EXPECT_EQ(ring->drain([](const trace::Record&) {}), 1);
+}
+
+static void inner() {
+  LZ_TRACE_SCOPE("test.inner");
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+static void outer() {
+  LZ_TRACE_SCOPE("test.outer");
+  inner();
+  inner();
+}
+
+TEST(CollectorTest, WritesPercentilesAndFoldedStacks) {
+  auto prefix = std::filesystem::temp_directory_path() / "lz_trace_test";
+  {
+    trace::Collector collector(prefix, std::chrono::milliseconds(5));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+      threads.emplace_back([] {
+        for (int i = 0; i < 10; ++i) {
+          outer();
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto outerTimes = collector.histogram("test.outer");
+    auto innerTimes = collector.histogram("test.inner");
+    EXPECT_EQ(outerTimes.count(), 20);
+    EXPECT_EQ(innerTimes.count(), 40);
+    EXPECT_GE(innerTimes.min(), 200'000);
+    EXPECT_GE(outerTimes.percentile(0.5), 2 * innerTimes.min());
+  }
+
+  std::ifstream txt(prefix.string() + ".txt");
+  std::stringstream report;
+  report << txt.rdbuf();
+  // every span of the test's own threads is there. the main thread's ring
+  // may have dropped records of other suites' probes, so the dropped line
+  // is only checked to be there.
+  std::map<std::string, uint64_t> counts;
+  std::string row;
+  while (std::getline(report, row)) {
+    std::istringstream fields(row);
+    std::string name;
+    uint64_t count = 0;
+    if (fields >> name >> count) {
+      counts[name] = count;
+    }
+  }
+  EXPECT_EQ(counts["test.outer"], 20);
+  EXPECT_EQ(counts["test.inner"], 40);
+  EXPECT_NE(report.str().find("\ndropped "), std::string::npos);
+
+  // per thread: outer's own time, and inner's below it
+  std::ifstream folded(prefix.string() + ".folded");
+  std::string line;
+  int outerLines = 0;
+  int innerLines = 0;
+  while (std::getline(folded, line)) {
+    auto space = line.rfind(' ');
+    std::string stack = line.substr(0, space);
+    ASSERT_EQ(stack.rfind("thread-", 0), 0) << line;
+    outerLines += stack.ends_with(";test.outer");
+    if (stack.ends_with(";test.outer;test.inner")) {
+      ++innerLines;
+      EXPECT_GE(std::stoull(line.substr(space + 1)), 10 * 2 * 200'000);
+    }
+  }
+  EXPECT_EQ(outerLines, 2);
+  EXPECT_EQ(innerLines, 2);
+  std::filesystem::remove(prefix.string() + ".txt");
+  std::filesystem::remove(prefix.string() + ".folded");
+}
+
+TEST(CollectorTest, RingsOfExitedThreadsGoWithoutACollector) {
+  auto& registry = trace::Registry::instance();
+  std::size_t before = registry.size();
+  for (int t = 0; t < 8; ++t) {
+    std::thread([] { inner(); }).join();
+  }
+  EXPECT_LE(registry.size(), before);
+  // a probe in a thread_local destructor, after the ring went, records
+  // nothing and touches nothing
+  struct LateProbe {
+    ~LateProbe() {
+      LZ_TRACE_SCOPE("test.late");
+    }
+  };
+  std::thread([] {
+    thread_local LateProbe late;
+    (void)late;
+    inner();  // the ring first, so it is destroyed before late
+  }).join();
+  EXPECT_LE(registry.size(), before);
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,117 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-10-27
+ * @LastEditors: lize
+ */
+
+#include "treiber_stack.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "atomic_taggedpointer.h"
+
+namespace lz {
+namespace test {
+using Taggedpointer::AtomicTaggedPointer;
+using Taggedpointer::TreiberStack;
+
+struct Leaf {
+  int value = 0;
+};
+struct Branch {
+  int value = 0;
+};
+
+TEST(AtomicTaggedPointerTest, CasBumpsGeneration) {
+  using Atomic = AtomicTaggedPointer<Leaf, Branch>;
+  Leaf leaf;
+  Branch branch;
+  Atomic atomic{Atomic::Pointer(&leaf)};
+  EXPECT_TRUE(atomic.is_lock_free());
+
+  auto expected = atomic.load();
+  EXPECT_TRUE(atomic.compare_exchange_strong(expected, &branch));
+  auto now = atomic.load();
+  EXPECT_EQ(now.Index(), 1);
+  EXPECT_EQ(now.Get<Branch>(), &branch);
+  EXPECT_EQ(Atomic::Generation(now), Atomic::Generation(expected) + 1);
+}
+
+TEST(AtomicTaggedPointerTest, StaleCasFailsAfterAba) {
+  using Atomic = AtomicTaggedPointer<Leaf, Branch>;
+  Leaf a;
+  Leaf b;
+  Atomic atomic{Atomic::Pointer(&a)};
+  auto stale = atomic.load();
+
+  // A -> B -> A: same address, newer generation
+  auto cur = atomic.load();
+  ASSERT_TRUE(atomic.compare_exchange_strong(cur, &b));
+  cur = atomic.load();
+  ASSERT_TRUE(atomic.compare_exchange_strong(cur, &a));
+  EXPECT_EQ(atomic.load().Get<Leaf>(), &a);
+
+  EXPECT_FALSE(atomic.compare_exchange_strong(stale, &b));
+  EXPECT_EQ(stale, atomic.load());
+}
+
+TEST(AtomicTaggedPointerTest, CasKeepsPayload) {
+  using Atomic = AtomicTaggedPointer<Taggedpointer::Payload<6>, Leaf, Branch>;
+  static_assert(Atomic::kGenerationBits == 16 - 1 - 6);
+  Leaf leaf;
+  Branch branch;
+  Atomic atomic{Atomic::Pointer(&leaf, 0x2A)};
+
+  auto expected = atomic.load();
+  EXPECT_TRUE(atomic.compare_exchange_strong(expected, {&branch, 0x15}));
+  auto now = atomic.load();
+  EXPECT_EQ(now.payload(), 0x15);
+  EXPECT_EQ(now.Get<Branch>(), &branch);
+  EXPECT_EQ(Atomic::Generation(now), 1);
+}
+
+TEST(TreiberStackTest, Lifo) {
+  TreiberStack<int> stack;
+  EXPECT_TRUE(stack.empty());
+  stack.push(1);
+  stack.push(2);
+  EXPECT_EQ(stack.pop(), 2);
+  EXPECT_EQ(stack.pop(), 1);
+  EXPECT_EQ(stack.pop(), std::nullopt);
+}
+
+TEST(TreiberStackTest, ConcurrentPushPopKeepsEveryValue) {
+  constexpr int kThreads = 4;
+  constexpr int kPerThread = 20000;
+  TreiberStack<int> stack;
+  std::vector<std::thread> threads;
+  std::vector<int64_t> sums(kThreads, 0);
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 1; i <= kPerThread; ++i) {
+        stack.push(i);
+        if (i % 2 == 0) {
+          sums[t] += *stack.pop();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  int64_t total = 0;
+  for (auto sum : sums) {
+    total += sum;
+  }
+  while (auto value = stack.pop()) {
+    total += *value;
+  }
+  EXPECT_EQ(total, int64_t{kThreads} * kPerThread * (kPerThread + 1) / 2);
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,137 @@
+/*
+ * @Description:
+ * @Author: lize
+ * @Date: 2025-10-28
+ * @LastEditors: lize
+ */
+
+#include "unique_taggedpointer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lz {
+namespace test {
+using Taggedpointer::HeapSlabs;
+using Taggedpointer::SlabPool;
+using Taggedpointer::TaggedPointer;
+using Taggedpointer::UniqueTaggedPointer;
+
+struct Counted {
+  static inline int alive = 0;
+  Counted() {
+    ++alive;
+  }
+  ~Counted() {
+    --alive;
+  }
+};
+struct Small : Counted {
+  int value = 1;
+};
+struct Large : Counted {
+  int values[16] = {2};
+};
+using Owned = UniqueTaggedPointer<TaggedPointer<Small, Large>>;
+
+TEST(UniqueTaggedPointerTest, DestroysConcreteType) {
+  {
+    auto small = Owned::Make<Small>();
+    auto large = Owned::Make<Large>();
+    EXPECT_EQ(Counted::alive, 2);
+    EXPECT_EQ(large->Index(), 1);
+    EXPECT_EQ(large->Get<Large>()->values[0], 2);
+  }
+  EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(UniqueTaggedPointerTest, MoveTransfersOwnership) {
+  auto a = Owned::Make<Small>();
+  Owned b = std::move(a);
+  EXPECT_FALSE(a);
+  EXPECT_TRUE(b);
+  Owned c;
+  c = std::move(b);
+  EXPECT_EQ(Counted::alive, 1);
+  c.reset();
+  EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(UniqueTaggedPointerTest, PoolReusesFreedBlocks) {
+  Small* first = SlabPool<Small>::New();
+  SlabPool<Small>::Delete(first);
+  Small* second = SlabPool<Small>::New();
+  EXPECT_EQ(first, second);
+  SlabPool<Small>::Delete(second);
+
+  std::set<Small*> seen;
+  for (int i = 0; i < 10000; ++i) {
+    seen.insert(SlabPool<Small>::New());
+  }
+  EXPECT_EQ(seen.size(), 10000);
+  for (auto* ptr : seen) {
+    SlabPool<Small>::Delete(ptr);
+  }
+  EXPECT_EQ(Counted::alive, 0);
+}
+
+// counts the slabs a pool takes from the heap
+struct CountingSlabs {
+  static inline std::atomic<int> taken = 0;
+  static void* Allocate(std::size_t bytes, std::size_t align) {
+    ++taken;
+    return HeapSlabs::Allocate(bytes, align);
+  }
+  static void Release(void* slab, std::size_t bytes, std::size_t align) {
+    HeapSlabs::Release(slab, bytes, align);
+  }
+};
+
+// one thread allocates and another frees: the freeing thread must hand its
+// blocks back instead of hoarding them while the other carves new slabs
+TEST(UniqueTaggedPointerTest, PoolStaysBoundedAcrossThreads) {
+  using Pool = SlabPool<Small, CountingSlabs>;
+  constexpr int kRounds = 100;
+  constexpr int kBatch = 5000;
+  std::vector<Small*> batch;
+  // even turns are the producer's, odd ones the consumer's
+  std::atomic<int> turn{0};
+  auto waitFor = [&turn](int mine) {
+    while (turn.load(std::memory_order_acquire) != mine) {
+      std::this_thread::yield();
+    }
+  };
+  std::thread producer([&] {
+    for (int round = 0; round < kRounds; ++round) {
+      waitFor(2 * round);
+      for (int i = 0; i < kBatch; ++i) {
+        batch.push_back(Pool::New());
+      }
+      turn.store(2 * round + 1, std::memory_order_release);
+    }
+  });
+  std::thread consumer([&] {
+    for (int round = 0; round < kRounds; ++round) {
+      waitFor(2 * round + 1);
+      for (auto* ptr : batch) {
+        Pool::Delete(ptr);
+      }
+      batch.clear();
+      turn.store(2 * round + 2, std::memory_order_release);
+    }
+  });
+  producer.join();
+  consumer.join();
+  EXPECT_EQ(Counted::alive, 0);
+  // half a million objects went through; a few slabs cover what is ever
+  // live plus each thread's cached blocks
+  EXPECT_LE(CountingSlabs::taken.load(), 5);
+}
+
+}  // namespace test
+}  // namespace lz
@@ -0,0 +1,711 @@
+/*
+ * @Description: B+tree ordered set with cache-line nodes and SIMD key search
+ * @Author: lize
+ * @Date: 2025-11-06
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace lz {
+namespace btree {
+namespace detail {
+
+// 4- and 8-byte integers under plain < are searched with vector compares
+template <typename Value, typename Compare>
+constexpr bool simdKeys() {
+  return std::is_integral_v<Value> && !std::is_same_v<Value, bool> &&
+         (sizeof(Value) == 4 || sizeof(Value) == 8) &&
+         (std::is_same_v<Compare, std::less<Value>> ||
+          std::is_same_v<Compare, std::less<>>);
+}
+
+#if defined(__AVX2__)
+struct Simd {
+  using Reg = __m256i;
+  static constexpr std::size_t kBytes = 32;
+  static constexpr bool kWide = true;  // has a 64-bit compare
+  static Reg load(const void* at) {
+    return _mm256_load_si256(static_cast<const Reg*>(at));
+  }
+  static Reg splat(int32_t v) {
+    return _mm256_set1_epi32(v);
+  }
+  static Reg splat(int64_t v) {
+    return _mm256_set1_epi64x(v);
+  }
+  static Reg bitXor(Reg a, Reg b) {
+    return _mm256_xor_si256(a, b);
+  }
+  template <typename Lane>
+  static Reg greater(Reg a, Reg b) {
+    if constexpr (sizeof(Lane) == 4) {
+      return _mm256_cmpgt_epi32(a, b);
+    } else {
+      return _mm256_cmpgt_epi64(a, b);
+    }
+  }
+  // one bit per byte
+  static uint32_t bytes(Reg r) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(r));
+  }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Simd {
+  using Reg = __m128i;
+  static constexpr std::size_t kBytes = 16;
+#if defined(__SSE4_2__)
+  static constexpr bool kWide = true;
+#else
+  static constexpr bool kWide = false;
+#endif
+  static Reg load(const void* at) {
+    return _mm_load_si128(static_cast<const Reg*>(at));
+  }
+  static Reg splat(int32_t v) {
+    return _mm_set1_epi32(v);
+  }
+  static Reg splat(int64_t v) {
+    return _mm_set1_epi64x(v);
+  }
+  static Reg bitXor(Reg a, Reg b) {
+    return _mm_xor_si128(a, b);
+  }
+  template <typename Lane>
+  static Reg greater(Reg a, Reg b) {
+    if constexpr (sizeof(Lane) == 4) {
+      return _mm_cmpgt_epi32(a, b);
+#if defined(__SSE4_2__)
+    } else {
+      return _mm_cmpgt_epi64(a, b);
+#endif
+    }
+  }
+  static uint32_t bytes(Reg r) {
+    return static_cast<uint32_t>(_mm_movemask_epi8(r));
+  }
+};
+#endif
+
+template <typename Value>
+constexpr bool simdAvailable() {
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  return sizeof(Value) == 4 || Simd::kWide;
+#else
+  return false;
+#endif
+}
+
+// how many of keys[0, count) are below key (Strict) or not above it. keys
+// are ascending, so that is a prefix and the scan stops at the first block
+// it does not fill. keys must be aligned to, and readable up to, a
+// multiple of 32 bytes.
+template <bool Strict, typename Value>
+std::size_t countPrefix(const Value* keys, std::size_t count, Value key) {
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  if constexpr (simdAvailable<Value>()) {
+    // the fixed-width lane, so long long and long pick a splat overload
+    using Lane = std::conditional_t<sizeof(Value) == 4, int32_t, int64_t>;
+    constexpr std::size_t kLanes = Simd::kBytes / sizeof(Value);
+    // unsigned order is signed order with the top bit flipped
+    constexpr Lane kFlip =
+      std::is_signed_v<Value> ? Lane{0} : std::numeric_limits<Lane>::min();
+    const auto flip = Simd::splat(kFlip);
+    const auto needle = Simd::splat(static_cast<Lane>(key) ^ kFlip);
+    std::size_t below = 0;
+    for (std::size_t i = 0; i < count; i += kLanes) {
+      auto block = Simd::bitXor(Simd::load(keys + i), flip);
+      uint32_t in = Strict ? Simd::bytes(Simd::greater<Lane>(needle, block))
+                           : ~Simd::bytes(Simd::greater<Lane>(block, needle));
+      std::size_t valid = std::min(count - i, kLanes);
+      in &= valid * sizeof(Value) == 32
+              ? ~uint32_t{0}
+              : (uint32_t{1} << valid * sizeof(Value)) - 1;
+      std::size_t n = std::popcount(in) / sizeof(Value);
+      below += n;
+      if (n < kLanes) {
+        break;
+      }
+    }
+    return below;
+  }
+#endif
+  std::size_t below = 0;
+  while (below < count && (Strict ? keys[below] < key : keys[below] <= key)) {
+    ++below;
+  }
+  return below;
+}
+}  // namespace detail
+
+// a B+tree: values live in leaves chained left to right, inner nodes hold
+// separators, and child i of an inner node holds keys[i - 1] <= v <
+// keys[i]. every node is aligned to a cache line and sized to about
+// NodeBytes, so a level costs a few adjacent lines instead of the one miss
+// per level of a binary tree. keys of 4- or 8-byte integers under
+// std::less are searched with SSE2/AVX2 compares, other keys by binary
+// search with Compare. readers and writers share one mutex, as in
+// RBTree's Locked mode.
+template <typename Value,
+          typename Compare = std::less<Value>,
+          std::size_t NodeBytes = 256>
+class BTree {
+  static constexpr bool kSimd = detail::simdKeys<Value, Compare>();
+  // capacities round down to whole 32-byte blocks for the vector loads
+  static constexpr std::size_t kBlock = kSimd ? 32 / sizeof(Value) : 1;
+  static constexpr std::size_t capacity(std::size_t room,
+                                        std::size_t perKey) {
+    return std::max<std::size_t>(4, room / perKey / kBlock * kBlock);
+  }
+
+ public:
+  static constexpr std::size_t kLeafKeys =
+    capacity(NodeBytes - sizeof(void*) - 8, sizeof(Value));
+  static constexpr std::size_t kInnerKeys =
+    capacity(NodeBytes - sizeof(void*) - 8, sizeof(Value) + sizeof(void*));
+
+  BTree() = default;
+  BTree(const BTree&) = delete;
+  BTree& operator=(const BTree&) = delete;
+  ~BTree() {
+    if (_root != nullptr) {
+      destroy(_root, _height);
+    }
+  }
+
+  template <typename T>
+    requires std::is_convertible_v<T, Value>
+  bool insert(T&& value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root == nullptr) {
+      _root = newLeaf();
+      _height = 0;
+    }
+    Path path;
+    Leaf* leaf = descend(value, &path);
+    std::size_t pos = lowerBound(leaf->_keys, leaf->_count, value);
+    if (pos < leaf->_count && !_compare(value, leaf->_keys[pos])) {
+      return false;
+    }
+    ++_count;
+    if (leaf->_count < kLeafKeys) {
+      insertKey(leaf, pos, std::forward<T>(value));
+      return true;
+    }
+    // a full leaf splits in two; the right half's first key goes up
+    Leaf* right = newLeaf();
+    constexpr std::size_t m = (kLeafKeys + 1) / 2;
+    std::move(leaf->_keys + m, leaf->_keys + kLeafKeys, right->_keys);
+    resetKeys(leaf->_keys + m, leaf->_keys + kLeafKeys);
+    right->_count = kLeafKeys - m;
+    leaf->_count = m;
+    right->_next = leaf->_next;
+    leaf->_next = right;
+    if (pos <= m) {
+      insertKey(leaf, pos, std::forward<T>(value));
+    } else {
+      insertKey(right, pos - m, std::forward<T>(value));
+    }
+    insertSeparator(path, right->_keys[0], right);
+    return true;
+  }
+
+  // returns false if the value was not in the tree
+  bool remove(const Value& value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root == nullptr) {
+      return false;
+    }
+    Path path;
+    Leaf* leaf = descend(value, &path);
+    std::size_t pos = lowerBound(leaf->_keys, leaf->_count, value);
+    if (pos == leaf->_count || _compare(value, leaf->_keys[pos])) {
+      return false;
+    }
+    eraseKey(leaf, pos);
+    --_count;
+    if (path.depth == 0) {
+      if (leaf->_count == 0) {
+        deleteNode(leaf);
+        _root = nullptr;
+      }
+      return true;
+    }
+    if (leaf->_count < kLeafKeys / 2) {
+      fixLeaf(path, leaf);
+    }
+    return true;
+  }
+
+  // the stored value, or nullptr; valid until that value is removed or
+  // its leaf changes
+  const Value* find(const Value& value) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root == nullptr) {
+      return nullptr;
+    }
+    const Leaf* leaf = descend(value, nullptr);
+    std::size_t pos = lowerBound(leaf->_keys, leaf->_count, value);
+    if (pos == leaf->_count || _compare(value, leaf->_keys[pos])) {
+      return nullptr;
+    }
+    return &leaf->_keys[pos];
+  }
+  const Value* findMin() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root == nullptr) {
+      return nullptr;
+    }
+    void* node = _root;
+    for (int level = _height; level > 0; --level) {
+      node = static_cast<Inner*>(node)->_children[0];
+    }
+    return &static_cast<Leaf*>(node)->_keys[0];
+  }
+
+  // func(value) for every value in [lo, hi), ascending, under the lock:
+  // func must not modify the tree. returns how many values were visited.
+  template <typename Func>
+  std::size_t for_each_in_range(const Value& lo,
+                                const Value& hi,
+                                Func&& func) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root == nullptr) {
+      return 0;
+    }
+    std::size_t visited = 0;
+    const Leaf* leaf = descend(lo, nullptr);
+    std::size_t pos = lowerBound(leaf->_keys, leaf->_count, lo);
+    for (; leaf != nullptr; leaf = leaf->_next, pos = 0) {
+      for (; pos < leaf->_count; ++pos) {
+        if (!_compare(leaf->_keys[pos], hi)) {
+          return visited;
+        }
+        func(leaf->_keys[pos]);
+        ++visited;
+      }
+    }
+    return visited;
+  }
+
+  std::size_t size() const {
+    return _count;
+  }
+  bool empty() const {
+    return _count == 0;
+  }
+  // bytes the nodes take, for comparing layouts
+  std::size_t bytes() const {
+    return _leaves * sizeof(Leaf) + _inners * sizeof(Inner);
+  }
+
+  // (valid, levels): key order and separator bounds, node fill, every leaf
+  // at the same depth, and the leaf chain holding size() values in order
+  std::pair<bool, int> checkBTree() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root == nullptr) {
+      return {_count == 0, 0};
+    }
+    const Leaf* first = nullptr;
+    if (!checkNode(_root, _height, nullptr, nullptr, true, &first)) {
+      return {false, -1};
+    }
+    std::size_t chained = 0;
+    const Value* last = nullptr;
+    for (const Leaf* leaf = first; leaf != nullptr; leaf = leaf->_next) {
+      if (last != nullptr && !_compare(*last, leaf->_keys[0])) {
+        return {false, -1};
+      }
+      chained += leaf->_count;
+      last = &leaf->_keys[leaf->_count - 1];
+    }
+    if (chained != _count) {
+      return {false, -1};
+    }
+    return {true, _height + 1};
+  }
+  void printTree() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root != nullptr) {
+      printNode(_root, _height, 0);
+    }
+  }
+
+ private:
+  // room for a 2^32-value tree at the minimum fanout of 2
+  static constexpr int kMaxHeight = 40;
+  static constexpr std::size_t kMinInnerKeys = (kInnerKeys - 1) / 2;
+
+  struct alignas(64) Leaf {
+    Value _keys[kLeafKeys]{};
+    Leaf* _next = nullptr;
+    uint16_t _count = 0;
+  };
+  // a child is an Inner above level 1 and a Leaf at level 1
+  struct alignas(64) Inner {
+    Value _keys[kInnerKeys]{};
+    void* _children[kInnerKeys + 1]{};
+    uint16_t _count = 0;
+  };
+
+  // the inner nodes from the root down to a leaf, and the child taken
+  struct Path {
+    std::array<Inner*, kMaxHeight> nodes;
+    std::array<std::size_t, kMaxHeight> slots;
+    int depth = 0;
+  };
+
+  std::size_t lowerBound(const Value* keys,
+                         std::size_t count,
+                         const Value& value) const {
+    if constexpr (kSimd) {
+      return detail::countPrefix<true>(keys, count, value);
+    } else {
+      return std::lower_bound(keys, keys + count, value, _compare) - keys;
+    }
+  }
+  std::size_t upperBound(const Value* keys,
+                         std::size_t count,
+                         const Value& value) const {
+    if constexpr (kSimd) {
+      return detail::countPrefix<false>(keys, count, value);
+    } else {
+      return std::upper_bound(keys, keys + count, value, _compare) - keys;
+    }
+  }
+
+  // the leaf that holds value or would; records the way down if asked
+  Leaf* descend(const Value& value, Path* path) const {
+    void* node = _root;
+    for (int level = _height; level > 0; --level) {
+      auto* inner = static_cast<Inner*>(node);
+      std::size_t slot = upperBound(inner->_keys, inner->_count, value);
+      if (path != nullptr) {
+        path->nodes[path->depth] = inner;
+        path->slots[path->depth] = slot;
+        ++path->depth;
+      }
+      node = inner->_children[slot];
+    }
+    return static_cast<Leaf*>(node);
+  }
+
+  static void resetKeys(Value* begin, Value* end) {
+    if constexpr (!std::is_trivially_copyable_v<Value>) {
+      std::fill(begin, end, Value{});
+    }
+  }
+
+  template <typename T>
+  static void insertKey(Leaf* leaf, std::size_t pos, T&& value) {
+    std::move_backward(leaf->_keys + pos,
+                       leaf->_keys + leaf->_count,
+                       leaf->_keys + leaf->_count + 1);
+    leaf->_keys[pos] = std::forward<T>(value);
+    ++leaf->_count;
+  }
+  static void eraseKey(Leaf* leaf, std::size_t pos) {
+    std::move(leaf->_keys + pos + 1,
+              leaf->_keys + leaf->_count,
+              leaf->_keys + pos);
+    --leaf->_count;
+    resetKeys(leaf->_keys + leaf->_count, leaf->_keys + leaf->_count + 1);
+  }
+  // separator at keys[pos] with child right after it
+  static void insertKey(Inner* node,
+                        std::size_t pos,
+                        Value separator,
+                        void* child) {
+    std::move_backward(node->_keys + pos,
+                       node->_keys + node->_count,
+                       node->_keys + node->_count + 1);
+    std::move_backward(node->_children + pos + 1,
+                       node->_children + node->_count + 1,
+                       node->_children + node->_count + 2);
+    node->_keys[pos] = std::move(separator);
+    node->_children[pos + 1] = child;
+    ++node->_count;
+  }
+  // drops keys[pos] and the child right after it
+  static void eraseKey(Inner* node, std::size_t pos) {
+    std::move(node->_keys + pos + 1,
+              node->_keys + node->_count,
+              node->_keys + pos);
+    std::move(node->_children + pos + 2,
+              node->_children + node->_count + 1,
+              node->_children + pos + 1);
+    --node->_count;
+    resetKeys(node->_keys + node->_count, node->_keys + node->_count + 1);
+  }
+
+  // hangs child right of separator in the leaf's parent, splitting full
+  // inner nodes on the way up, and the root last
+  void insertSeparator(const Path& path, Value separator, void* child) {
+    for (int level = path.depth - 1; level >= 0; --level) {
+      Inner* node = path.nodes[level];
+      std::size_t pos = path.slots[level];
+      if (node->_count < kInnerKeys) {
+        insertKey(node, pos, std::move(separator), child);
+        return;
+      }
+      // keys[m] moves up; the right node takes what is above it
+      Inner* right = newInner();
+      constexpr std::size_t m = kInnerKeys / 2;
+      Value up = std::move(node->_keys[m]);
+      std::move(node->_keys + m + 1, node->_keys + kInnerKeys, right->_keys);
+      std::copy(node->_children + m + 1,
+                node->_children + kInnerKeys + 1,
+                right->_children);
+      resetKeys(node->_keys + m, node->_keys + kInnerKeys);
+      right->_count = kInnerKeys - m - 1;
+      node->_count = m;
+      if (pos <= m) {
+        insertKey(node, pos, std::move(separator), child);
+      } else {
+        insertKey(right, pos - m - 1, std::move(separator), child);
+      }
+      separator = std::move(up);
+      child = right;
+    }
+    Inner* root = newInner();
+    root->_keys[0] = std::move(separator);
+    root->_children[0] = _root;
+    root->_children[1] = child;
+    root->_count = 1;
+    _root = root;
+    ++_height;
+  }
+
+  // the leaf is one short: borrow from a sibling that can spare a value,
+  // else merge with one and fix the parent
+  void fixLeaf(const Path& path, Leaf* leaf) {
+    Inner* parent = path.nodes[path.depth - 1];
+    std::size_t slot = path.slots[path.depth - 1];
+    auto* left =
+      slot > 0 ? static_cast<Leaf*>(parent->_children[slot - 1]) : nullptr;
+    auto* right = slot < parent->_count
+                    ? static_cast<Leaf*>(parent->_children[slot + 1])
+                    : nullptr;
+    if (left != nullptr && left->_count > kLeafKeys / 2) {
+      insertKey(leaf, 0, std::move(left->_keys[left->_count - 1]));
+      eraseKey(left, left->_count - 1);
+      parent->_keys[slot - 1] = leaf->_keys[0];
+      return;
+    }
+    if (right != nullptr && right->_count > kLeafKeys / 2) {
+      insertKey(leaf, leaf->_count, std::move(right->_keys[0]));
+      eraseKey(right, 0);
+      parent->_keys[slot] = right->_keys[0];
+      return;
+    }
+    if (left != nullptr) {
+      mergeLeaves(left, leaf);
+      eraseKey(parent, slot - 1);
+    } else {
+      mergeLeaves(leaf, right);
+      eraseKey(parent, slot);
+    }
+    fixInner(path, path.depth - 1);
+  }
+  void mergeLeaves(Leaf* into, Leaf* from) {
+    std::move(from->_keys,
+              from->_keys + from->_count,
+              into->_keys + into->_count);
+    into->_count += from->_count;
+    into->_next = from->_next;
+    deleteNode(from);
+  }
+
+  // the same for an inner node, whose borrowed child brings the parent's
+  // separator down; merging may cascade up to the root
+  void fixInner(const Path& path, int level) {
+    for (; level > 0; --level) {
+      Inner* node = path.nodes[level];
+      if (node->_count >= kMinInnerKeys) {
+        return;
+      }
+      Inner* parent = path.nodes[level - 1];
+      std::size_t slot = path.slots[level - 1];
+      auto* left =
+        slot > 0 ? static_cast<Inner*>(parent->_children[slot - 1]) : nullptr;
+      auto* right = slot < parent->_count
+                      ? static_cast<Inner*>(parent->_children[slot + 1])
+                      : nullptr;
+      if (left != nullptr && left->_count > kMinInnerKeys) {
+        std::move_backward(node->_keys,
+                           node->_keys + node->_count,
+                           node->_keys + node->_count + 1);
+        std::move_backward(node->_children,
+                           node->_children + node->_count + 1,
+                           node->_children + node->_count + 2);
+        node->_keys[0] = std::move(parent->_keys[slot - 1]);
+        node->_children[0] = left->_children[left->_count];
+        ++node->_count;
+        parent->_keys[slot - 1] = std::move(left->_keys[left->_count - 1]);
+        --left->_count;
+        resetKeys(left->_keys + left->_count, left->_keys + left->_count + 1);
+        return;
+      }
+      if (right != nullptr && right->_count > kMinInnerKeys) {
+        node->_keys[node->_count] = std::move(parent->_keys[slot]);
+        node->_children[node->_count + 1] = right->_children[0];
+        ++node->_count;
+        parent->_keys[slot] = std::move(right->_keys[0]);
+        std::move(right->_keys + 1, right->_keys + right->_count, right->_keys);
+        std::move(right->_children + 1,
+                  right->_children + right->_count + 1,
+                  right->_children);
+        --right->_count;
+        resetKeys(right->_keys + right->_count,
+                  right->_keys + right->_count + 1);
+        return;
+      }
+      if (left != nullptr) {
+        mergeInner(left, std::move(parent->_keys[slot - 1]), node);
+        eraseKey(parent, slot - 1);
+      } else {
+        mergeInner(node, std::move(parent->_keys[slot]), right);
+        eraseKey(parent, slot);
+      }
+    }
+    // the root may be left with one child, which then takes its place
+    auto* root = static_cast<Inner*>(_root);
+    if (root->_count == 0) {
+      _root = root->_children[0];
+      deleteNode(root);
+      --_height;
+    }
+  }
+  void mergeInner(Inner* into, Value separator, Inner* from) {
+    into->_keys[into->_count] = std::move(separator);
+    std::move(from->_keys,
+              from->_keys + from->_count,
+              into->_keys + into->_count + 1);
+    std::copy(from->_children,
+              from->_children + from->_count + 1,
+              into->_children + into->_count + 1);
+    into->_count += from->_count + 1;
+    deleteNode(from);
+  }
+
+  Leaf* newLeaf() {
+    ++_leaves;
+    return new Leaf();
+  }
+  Inner* newInner() {
+    ++_inners;
+    return new Inner();
+  }
+  void deleteNode(Leaf* leaf) {
+    --_leaves;
+    delete leaf;
+  }
+  void deleteNode(Inner* inner) {
+    --_inners;
+    delete inner;
+  }
+  void destroy(void* node, int level) {
+    if (level == 0) {
+      deleteNode(static_cast<Leaf*>(node));
+      return;
+    }
+    auto* inner = static_cast<Inner*>(node);
+    for (std::size_t i = 0; i <= inner->_count; ++i) {
+      destroy(inner->_children[i], level - 1);
+    }
+    deleteNode(inner);
+  }
+
+  // every key of node lies in [lo, hi) (a null bound is open)
+  bool checkNode(const void* node,
+                 int level,
+                 const Value* lo,
+                 const Value* hi,
+                 bool root,
+                 const Leaf** first) const {
+    auto inBounds = [&](const Value* keys, std::size_t count) {
+      for (std::size_t i = 0; i < count; ++i) {
+        if ((i > 0 && !_compare(keys[i - 1], keys[i])) ||
+            (lo != nullptr && _compare(keys[i], *lo)) ||
+            (hi != nullptr && !_compare(keys[i], *hi))) {
+          return false;
+        }
+      }
+      return true;
+    };
+    if (level == 0) {
+      auto* leaf = static_cast<const Leaf*>(node);
+      if (*first == nullptr) {
+        *first = leaf;
+      }
+      std::size_t min = root ? 1 : kLeafKeys / 2;
+      return leaf->_count >= min && leaf->_count <= kLeafKeys &&
+             inBounds(leaf->_keys, leaf->_count);
+    }
+    auto* inner = static_cast<const Inner*>(node);
+    std::size_t min = root ? 1 : kMinInnerKeys;
+    if (inner->_count < min || inner->_count > kInnerKeys ||
+        !inBounds(inner->_keys, inner->_count)) {
+      return false;
+    }
+    for (std::size_t i = 0; i <= inner->_count; ++i) {
+      const Value* childLo = i == 0 ? lo : &inner->_keys[i - 1];
+      const Value* childHi = i == inner->_count ? hi : &inner->_keys[i];
+      if (!checkNode(
+            inner->_children[i], level - 1, childLo, childHi, false, first)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void printNode(const void* node, int level, int indent) const {
+    const Value* keys;
+    std::size_t count;
+    if (level == 0) {
+      keys = static_cast<const Leaf*>(node)->_keys;
+      count = static_cast<const Leaf*>(node)->_count;
+    } else {
+      keys = static_cast<const Inner*>(node)->_keys;
+      count = static_cast<const Inner*>(node)->_count;
+    }
+    std::cout << std::string(indent * 4, ' ')
+              << (level == 0 ? "Leaf:" : "Inner:");
+    for (std::size_t i = 0; i < count; ++i) {
+      std::cout << ' ' << keys[i];
+    }
+    std::cout << std::endl;
+    if (level > 0) {
+      auto* inner = static_cast<const Inner*>(node);
+      for (std::size_t i = 0; i <= inner->_count; ++i) {
+        printNode(inner->_children[i], level - 1, indent + 1);
+      }
+    }
+  }
+
+  void* _root = nullptr;
+  int _height = 0;  // levels above the leaves
+  std::size_t _count = 0;
+  std::size_t _leaves = 0;
+  std::size_t _inners = 0;
+  [[no_unique_address]] Compare _compare{};
+  mutable std::mutex _mutex{};
+};
+}  // namespace btree
+}  // namespace lz
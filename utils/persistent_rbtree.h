@@ -0,0 +1,536 @@
+/*
+ * @Description: persistent red-black tree: writers copy the path, readers
+ * keep immutable snapshots
+ * @Author: lize
+ * @Date: 2025-11-08
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "rbtree.h"
+
+namespace lz {
+namespace rbtree {
+
+// a node is never modified once built, so any number of versions share it.
+// it counts the parents and snapshots holding it and frees itself, and
+// releases its children, when the last one lets go.
+template <typename Value>
+class PersistentNode {
+ public:
+  // an owning reference; copying it shares the node
+  class Ref {
+   public:
+    Ref() = default;
+    Ref(const Ref& other) : _node(other._node) {
+      if (_node != nullptr) {
+        _node->_refs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    Ref(Ref&& other) noexcept : _node(std::exchange(other._node, nullptr)) {
+    }
+    Ref& operator=(Ref other) noexcept {
+      std::swap(_node, other._node);
+      return *this;
+    }
+    ~Ref() {
+      if (_node != nullptr &&
+          _node->_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete _node;
+      }
+    }
+
+    const PersistentNode* operator->() const {
+      return _node;
+    }
+    const PersistentNode* get() const {
+      return _node;
+    }
+    explicit operator bool() const {
+      return _node != nullptr;
+    }
+
+   private:
+    friend class PersistentNode;
+    explicit Ref(const PersistentNode* node) : _node(node) {
+    }
+
+    const PersistentNode* _node = nullptr;
+  };
+
+  template <typename T>
+  static Ref make(TreeColor color, Ref left, T&& value, Ref right) {
+    return Ref(new PersistentNode(
+      color, std::move(left), std::forward<T>(value), std::move(right)));
+  }
+
+  bool red() const {
+    return _color == TreeColor::RED;
+  }
+
+  Ref _left;
+  Ref _right;
+  Value _value;
+  TreeColor _color;
+
+ private:
+  template <typename T>
+  PersistentNode(TreeColor color, Ref left, T&& value, Ref right)
+    : _left(std::move(left)),
+      _right(std::move(right)),
+      _value(std::forward<T>(value)),
+      _color(color) {
+  }
+
+  mutable std::atomic<uint32_t> _refs{1};
+};
+
+// insert and remove build a new root-to-leaf path and share every other
+// node with the previous version, then publish the new root. writers take
+// a mutex, one at a time. snapshot() pins the current version in O(1);
+// the snapshot never changes, is read without any lock, and keeps its
+// nodes alive until it is dropped. insertion is Okasaki's balance and
+// removal is Kahrs', both of which only ever rebuild nodes on the path.
+template <typename Value, typename Compare = std::less<Value>>
+class PersistentRBTree {
+  using Node = PersistentNode<Value>;
+  using Ref = typename Node::Ref;
+
+  // one published version: freed once the tree has moved past it and its
+  // last snapshot is gone
+  struct Version {
+    Ref root;
+    std::size_t size = 0;
+    mutable std::atomic<uint32_t> refs{1};
+  };
+  static void release(const Version* version) {
+    if (version != nullptr &&
+        version->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete version;
+    }
+  }
+
+ public:
+  // one immutable version of the tree
+  class Snapshot {
+   public:
+    Snapshot() = default;
+    Snapshot(const Snapshot& other) : _version(other._version) {
+      if (_version != nullptr) {
+        _version->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    Snapshot(Snapshot&& other) noexcept
+      : _version(std::exchange(other._version, nullptr)) {
+    }
+    Snapshot& operator=(Snapshot other) noexcept {
+      std::swap(_version, other._version);
+      return *this;
+    }
+    ~Snapshot() {
+      release(_version);
+    }
+
+    // the stored value, or nullptr; valid while the snapshot lives
+    const Value* find(const Value& value) const {
+      return locate(root(), value, _compare);
+    }
+    const Value* findMin() const {
+      const Node* node = root();
+      if (node == nullptr) {
+        return nullptr;
+      }
+      while (node->_left) {
+        node = node->_left.get();
+      }
+      return &node->_value;
+    }
+
+    // func(value) for every value in [lo, hi), ascending. the walk keeps
+    // its path on the stack and allocates nothing. returns the count.
+    template <typename Func>
+    std::size_t for_each_in_range(const Value& lo,
+                                  const Value& hi,
+                                  Func&& func) const {
+      std::array<const Node*, kMaxDepth> stack;
+      int depth = 0;
+      // the path to lo, keeping only the nodes not below it
+      for (const Node* node = root(); node != nullptr;) {
+        if (_compare(node->_value, lo)) {
+          node = node->_right.get();
+        } else {
+          stack[depth++] = node;
+          node = node->_left.get();
+        }
+      }
+      std::size_t visited = 0;
+      while (depth > 0) {
+        const Node* node = stack[--depth];
+        if (!_compare(node->_value, hi)) {
+          break;
+        }
+        func(node->_value);
+        ++visited;
+        for (node = node->_right.get(); node != nullptr;
+             node = node->_left.get()) {
+          stack[depth++] = node;
+        }
+      }
+      return visited;
+    }
+    // func(value) for every value, ascending
+    template <typename Func>
+    std::size_t for_each(Func&& func) const {
+      std::array<const Node*, kMaxDepth> stack;
+      int depth = 0;
+      for (const Node* node = root(); node != nullptr;
+           node = node->_left.get()) {
+        stack[depth++] = node;
+      }
+      std::size_t visited = 0;
+      while (depth > 0) {
+        const Node* node = stack[--depth];
+        func(node->_value);
+        ++visited;
+        for (node = node->_right.get(); node != nullptr;
+             node = node->_left.get()) {
+          stack[depth++] = node;
+        }
+      }
+      return visited;
+    }
+
+    std::size_t size() const {
+      return _version ? _version->size : 0;
+    }
+    bool empty() const {
+      return size() == 0;
+    }
+
+    // (valid, black height of every path)
+    std::pair<bool, int> checkRbTree() const {
+      const Node* node = root();
+      if (node != nullptr && node->red()) {
+        return {false, -1};
+      }
+      std::size_t count = 0;
+      int height = checkEachPath(node, nullptr, nullptr, &count);
+      return {height != -1 && count == size(), height};
+    }
+
+   private:
+    friend class PersistentRBTree;
+    // adopts a reference the caller took
+    explicit Snapshot(const Version* version) : _version(version) {
+    }
+
+    const Node* root() const {
+      return _version ? _version->root.get() : nullptr;
+    }
+
+    // every value of node lies in (lo, hi) (a null bound is open)
+    int checkEachPath(const Node* node,
+                      const Value* lo,
+                      const Value* hi,
+                      std::size_t* count) const {
+      if (node == nullptr) {
+        return 1;
+      }
+      ++*count;
+      if ((lo != nullptr && !_compare(*lo, node->_value)) ||
+          (hi != nullptr && !_compare(node->_value, *hi))) {
+        return -1;
+      }
+      // a red node has no red child
+      if (node->red() && ((node->_left && node->_left->red()) ||
+                          (node->_right && node->_right->red()))) {
+        return -1;
+      }
+      int left = checkEachPath(node->_left.get(), lo, &node->_value, count);
+      int right = checkEachPath(node->_right.get(), &node->_value, hi, count);
+      if (left == -1 || left != right) {
+        return -1;
+      }
+      return left + (node->red() ? 0 : 1);
+    }
+
+    const Version* _version = nullptr;
+    [[no_unique_address]] Compare _compare{};
+  };
+
+  PersistentRBTree() : _current(word(new Version{})) {
+  }
+  PersistentRBTree(const PersistentRBTree&) = delete;
+  PersistentRBTree& operator=(const PersistentRBTree&) = delete;
+  ~PersistentRBTree() {
+    release(version(_current.load(std::memory_order_acquire)));
+  }
+
+  // lock-free: a split reference count. the reader first bumps a count kept
+  // in the spare top bits of the published word, which keeps the version
+  // alive, then takes a reference of its own and gives the first one back.
+  // a writer that swapped the version out meanwhile has already turned
+  // the top-bit count into references, so then it drops one of those.
+  Snapshot snapshot() const {
+    uint64_t seen =
+      _current.fetch_add(kOneReader, std::memory_order_acquire) + kOneReader;
+    const Version* pinned = version(seen);
+    pinned->refs.fetch_add(1, std::memory_order_relaxed);
+    while (version(seen) == pinned) {
+      // release publishes the refs increment above: a writer whose exchange
+      // reads this word, and so sees one reader fewer, sees our reference
+      if (_current.compare_exchange_weak(seen,
+                                         seen - kOneReader,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+        return Snapshot(pinned);
+      }
+    }
+    pinned->refs.fetch_sub(1, std::memory_order_relaxed);
+    return Snapshot(pinned);
+  }
+
+  template <typename T>
+    requires std::is_convertible_v<T, Value>
+  bool insert(T&& value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Version* current = version(_current.load(std::memory_order_relaxed));
+    Value inserted(std::forward<T>(value));
+    if (locate(current->root.get(), inserted, _compare) != nullptr) {
+      return false;
+    }
+    publish(blacken(insertBelow(current->root, inserted)), current->size + 1);
+    return true;
+  }
+
+  // returns false if the value was not in the tree
+  bool remove(const Value& value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Version* current = version(_current.load(std::memory_order_relaxed));
+    if (locate(current->root.get(), value, _compare) == nullptr) {
+      return false;
+    }
+    publish(blacken(removeBelow(current->root, value)), current->size - 1);
+    return true;
+  }
+
+  // a copy from the current version, or std::nullopt
+  std::optional<Value> find(const Value& value) const {
+    auto found = snapshot();
+    const Value* result = found.find(value);
+    return result == nullptr ? std::nullopt : std::optional<Value>(*result);
+  }
+  std::size_t size() const {
+    return snapshot().size();
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+
+ private:
+  // longer than any path in a valid tree of 2^32 nodes
+  static constexpr int kMaxDepth = 64;
+  static constexpr auto RED = TreeColor::RED;
+  static constexpr auto BLACK = TreeColor::BLACK;
+
+  static bool isRed(const Ref& node) {
+    return node && node->red();
+  }
+  static bool isBlack(const Ref& node) {
+    return node && !node->red();
+  }
+  static Ref make(TreeColor color, Ref left, const Value& value, Ref right) {
+    return Node::make(color, std::move(left), value, std::move(right));
+  }
+  // the same node in another color
+  static Ref paint(const Ref& node, TreeColor color) {
+    return make(color, node->_left, node->_value, node->_right);
+  }
+  static Ref blacken(Ref node) {
+    return isRed(node) ? paint(node, BLACK) : std::move(node);
+  }
+
+  // the published word: the version pointer in the low 48 bits, readers
+  // in the middle of snapshot() in the top 16
+  static constexpr int kPointerBits = 48;
+  static constexpr uint64_t kOneReader = uint64_t{1} << kPointerBits;
+  static uint64_t word(const Version* version) {
+    return reinterpret_cast<uint64_t>(version);
+  }
+  static const Version* version(uint64_t word) {
+    return reinterpret_cast<const Version*>(word & (kOneReader - 1));
+  }
+
+  void publish(Ref root, std::size_t size) {
+    uint64_t old = _current.exchange(word(new Version{std::move(root), size}),
+                                     std::memory_order_acq_rel);
+    // readers caught mid-snapshot become references; the tree drops its own
+    auto readers = static_cast<uint32_t>(old >> kPointerBits);
+    const Version* previous = version(old);
+    if (previous->refs.fetch_add(readers - 1, std::memory_order_acq_rel) ==
+        1 - readers) {
+      delete previous;
+    }
+  }
+
+  template <typename Cmp>
+  static const Value* locate(const Node* node,
+                             const Value& value,
+                             const Cmp& compare) {
+    while (node != nullptr) {
+      if (compare(value, node->_value)) {
+        node = node->_left.get();
+      } else if (compare(node->_value, value)) {
+        node = node->_right.get();
+      } else {
+        return &node->_value;
+      }
+    }
+    return nullptr;
+  }
+
+  // a black node over children where a red node may have a red child
+  static Ref balance(const Ref& a, const Value& x, const Ref& b) {
+    if (isRed(a) && isRed(b)) {
+      return make(RED, paint(a, BLACK), x, paint(b, BLACK));
+    }
+    if (isRed(a)) {
+      if (isRed(a->_left)) {
+        return make(RED,
+                    paint(a->_left, BLACK),
+                    a->_value,
+                    make(BLACK, a->_right, x, b));
+      }
+      if (isRed(a->_right)) {
+        return make(RED,
+                    make(BLACK, a->_left, a->_value, a->_right->_left),
+                    a->_right->_value,
+                    make(BLACK, a->_right->_right, x, b));
+      }
+    }
+    if (isRed(b)) {
+      if (isRed(b->_right)) {
+        return make(RED,
+                    make(BLACK, a, x, b->_left),
+                    b->_value,
+                    paint(b->_right, BLACK));
+      }
+      if (isRed(b->_left)) {
+        return make(RED,
+                    make(BLACK, a, x, b->_left->_left),
+                    b->_left->_value,
+                    make(BLACK, b->_left->_right, b->_value, b->_right));
+      }
+    }
+    return make(BLACK, a, x, b);
+  }
+
+  // value is not in the tree yet
+  Ref insertBelow(const Ref& node, const Value& value) const {
+    if (!node) {
+      return make(RED, Ref(), value, Ref());
+    }
+    bool left = _compare(value, node->_value);
+    Ref a = left ? insertBelow(node->_left, value) : node->_left;
+    Ref b = left ? node->_right : insertBelow(node->_right, value);
+    if (node->red()) {
+      return make(RED, std::move(a), node->_value, std::move(b));
+    }
+    return balance(a, node->_value, b);
+  }
+
+  // value is in the tree. a subtree whose root was black comes back one
+  // black level shorter, which balanceLeft/balanceRight repair.
+  Ref removeBelow(const Ref& node, const Value& value) const {
+    if (_compare(value, node->_value)) {
+      Ref a = removeBelow(node->_left, value);
+      if (isBlack(node->_left)) {
+        return balanceLeft(a, node->_value, node->_right);
+      }
+      return make(RED, std::move(a), node->_value, node->_right);
+    }
+    if (_compare(node->_value, value)) {
+      Ref b = removeBelow(node->_right, value);
+      if (isBlack(node->_right)) {
+        return balanceRight(node->_left, node->_value, b);
+      }
+      return make(RED, node->_left, node->_value, std::move(b));
+    }
+    return fuse(node->_left, node->_right);
+  }
+
+  // the left subtree a lost a black level
+  static Ref balanceLeft(const Ref& a, const Value& x, const Ref& b) {
+    if (isRed(a)) {
+      return make(RED, paint(a, BLACK), x, b);
+    }
+    if (isBlack(b)) {
+      return balance(a, x, paint(b, RED));
+    }
+    assert(isRed(b) && isBlack(b->_left));
+    return make(RED,
+                make(BLACK, a, x, b->_left->_left),
+                b->_left->_value,
+                balance(b->_left->_right, b->_value, paint(b->_right, RED)));
+  }
+  // the right subtree b lost a black level
+  static Ref balanceRight(const Ref& a, const Value& x, const Ref& b) {
+    if (isRed(b)) {
+      return make(RED, a, x, paint(b, BLACK));
+    }
+    if (isBlack(a)) {
+      return balance(paint(a, RED), x, b);
+    }
+    assert(isRed(a) && isBlack(a->_right));
+    return make(RED,
+                balance(paint(a->_left, RED), a->_value, a->_right->_left),
+                a->_right->_value,
+                make(BLACK, a->_right->_right, x, b));
+  }
+
+  // joins the two children of a removed node, every value of a below b
+  static Ref fuse(const Ref& a, const Ref& b) {
+    if (!a) {
+      return b;
+    }
+    if (!b) {
+      return a;
+    }
+    if (isBlack(a) && isRed(b)) {
+      return make(RED, fuse(a, b->_left), b->_value, b->_right);
+    }
+    if (isRed(a) && isBlack(b)) {
+      return make(RED, a->_left, a->_value, fuse(a->_right, b));
+    }
+    Ref middle = fuse(a->_right, b->_left);
+    TreeColor color = a->_color;
+    if (isRed(middle)) {
+      return make(RED,
+                  make(color, a->_left, a->_value, middle->_left),
+                  middle->_value,
+                  make(color, middle->_right, b->_value, b->_right));
+    }
+    if (color == RED) {
+      return make(
+        RED, a->_left, a->_value, make(RED, middle, b->_value, b->_right));
+    }
+    return balanceLeft(
+      a->_left, a->_value, make(BLACK, middle, b->_value, b->_right));
+  }
+
+  mutable std::atomic<uint64_t> _current;
+  [[no_unique_address]] Compare _compare{};
+  std::mutex _mutex;
+};
+}  // namespace rbtree
+}  // namespace lz
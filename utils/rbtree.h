@@ -1,5 +1,6 @@
 /*
- * @Description:
+ * @Description: red-black tree on an index arena with the color in the
+ * parent link
  * @Author: lize
  * @Date: 2024-08-10
  * @LastEditors: lize
@@ -8,583 +9,1865 @@
 #pragma once
 #include <algorithm>
 #include <atomic>
+#include <bit>
 #include <cassert>
-#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
+
+#include "trace_scope.h"
 namespace lz {
 namespace rbtree {
 enum class TreeColor : uint8_t { RED = 0U, BLACK };
 
-template <typename Value, typename Compare = std::less<Value>()>
-struct Node {
-  using NodeUPtr = std::unique_ptr<Node>;
-  using NodeSPtr = std::shared_ptr<Node>;
-  Node() = default;
-  explicit Node(Value value) : _value(std::move(value)) {
+// an arena index that optimistic readers may load while the writer stores
+// it. every access is a relaxed atomic, which is a plain mov on x86 and ARM.
+class Link {
+ public:
+  Link(uint32_t index = 0) : _index(index) {
   }
-  Node(Value value, TreeColor color) : _value(value), _color(color) {
+  Link(const Link& other) : _index(other) {
   }
-  NodeSPtr sibling() const {
-    if (_parent == nullptr) {
-      return nullptr;
+  Link& operator=(const Link& other) {
+    return *this = static_cast<uint32_t>(other);
+  }
+  Link& operator=(uint32_t index) {
+    std::atomic_ref<uint32_t>(_index).store(index, std::memory_order_relaxed);
+    return *this;
+  }
+  operator uint32_t() const {
+    return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(_index))
+      .load(std::memory_order_relaxed);
+  }
+
+ private:
+  uint32_t _index;
+};
+
+namespace detail {
+// the number of nodes under and including this one, for rank and select
+template <bool Ranked>
+struct SubtreeSize {};
+template <>
+struct SubtreeSize<true> {
+  uint32_t _size = 0;
+};
+}  // namespace detail
+
+// links are 32-bit arena indices and the color is the low bit of the parent
+// link, so an int tree spends 16 bytes per node, 20 when Ranked. index 0 is
+// the nil sentinel: always black, size 0, and its parent may be written
+// while erasing. ValueAlign raises the value's alignment where it is
+// accessed through std::atomic_ref, which may need more than alignof.
+template <typename Value,
+          bool Ranked = false,
+          std::size_t ValueAlign = alignof(Value)>
+struct ArenaNode : detail::SubtreeSize<Ranked> {
+  uint32_t parent() const {
+    return _parentColor >> 1;
+  }
+  TreeColor color() const {
+    return static_cast<TreeColor>(_parentColor & 1U);
+  }
+  void setParent(uint32_t parent) {
+    _parentColor = parent << 1 | (_parentColor & 1U);
+  }
+  void setColor(TreeColor color) {
+    _parentColor = (_parentColor & ~1U) | static_cast<uint32_t>(color);
+  }
+
+  Link _left = 0;
+  Link _right = 0;
+  Link _parentColor = static_cast<uint32_t>(TreeColor::BLACK);
+  alignas(ValueAlign) Value _value{};
+};
+
+// nodes live in fixed 4096-node chunks that never move, so references stay
+// valid while the tree grows. freed nodes are chained through _left and
+// reused first. chunks are only returned when the arena is destroyed, and
+// the chunk table is republished rather than reallocated in place, so a
+// reader without the lock can still resolve any index it has seen.
+template <typename Node>
+class NodeArena {
+ public:
+  static constexpr uint32_t kChunkBits = 12;
+  static constexpr uint32_t kChunkSize = 1U << kChunkBits;
+  // one bit of the parent link is the color
+  static constexpr uint32_t kMaxNodes = 1U << 31;
+
+  NodeArena() {
+    allocate();  // the nil sentinel
+  }
+  NodeArena(const NodeArena&) = delete;
+  NodeArena& operator=(const NodeArena&) = delete;
+
+  Node& operator[](uint32_t index) {
+    return _chunks[index >> kChunkBits][index & (kChunkSize - 1)];
+  }
+  const Node& operator[](uint32_t index) const {
+    return _chunks[index >> kChunkBits][index & (kChunkSize - 1)];
+  }
+
+  uint32_t allocate() {
+    if (_free != 0) {
+      uint32_t index = _free;
+      _free = (*this)[index]._left;
+      (*this)[index]._left = 0;
+      return index;
     }
-    if (this == _parent->_left.get()) {
-      return _parent->_right;
+    if (_end == _chunks.size() * kChunkSize) {
+      if (_end == kMaxNodes) {
+        throw std::length_error("rbtree: more than 2^31 nodes");
+      }
+      _chunks.push_back(std::make_unique<Node[]>(kChunkSize));
+      publish(_chunks.size() - 1);
     }
-    return _parent->_left;
+    return _end++;
+  }
+  // unlinks the node; its value is left to the caller
+  void release(uint32_t index) {
+    Node& node = (*this)[index];
+    node._left = _free;
+    node._right = 0;
+    node._parentColor = static_cast<uint32_t>(TreeColor::BLACK);
+    _free = index;
   }
 
-  NodeSPtr closestNephew() const {
-    if (_parent == nullptr) {
-      return nullptr;
-    }
-    if (_parent->_left == nullptr || _parent->_right == nullptr) {
+  // for readers that do not hold the writer's lock: the node, or nullptr if
+  // its chunk is not visible to this thread yet.
+  const Node* tryGet(uint32_t index) const {
+    const ChunkTable* table = _published.load(std::memory_order_acquire);
+    std::size_t chunk = index >> kChunkBits;
+    if (table == nullptr || chunk >= table->size) {
       return nullptr;
     }
-    if (this == _parent->_left.get()) {
-      return _parent->_right->_left;
-    }
-    return _parent->_left->_right;
+    Node* base = table->chunks[chunk].load(std::memory_order_acquire);
+    return base == nullptr ? nullptr : base + (index & (kChunkSize - 1));
   }
-  NodeSPtr distantNephew() const {
-    if (_parent == nullptr) {
-      return nullptr;
+
+  // memory held by the arena, free nodes included
+  std::size_t bytes() const {
+    std::size_t tables = 0;
+    for (auto& table : _tables) {
+      tables += table->size * sizeof(std::atomic<Node*>);
     }
-    if (_parent->_left == nullptr || _parent->_right == nullptr) {
-      return nullptr;
+    return _chunks.size() * kChunkSize * sizeof(Node) +
+           _chunks.capacity() * sizeof(_chunks[0]) + tables;
+  }
+
+ private:
+  struct ChunkTable {
+    std::size_t size;
+    std::unique_ptr<std::atomic<Node*>[]> chunks;
+  };
+
+  void publish(std::size_t chunk) {
+    Node* base = _chunks[chunk].get();
+    ChunkTable* table = _tables.empty() ? nullptr : _tables.back().get();
+    if (table != nullptr && chunk < table->size) {
+      table->chunks[chunk].store(base, std::memory_order_release);
+      return;
     }
-    if (this == _parent->_left.get()) {
-      return _parent->_right->_right;
+    // readers may still hold the old table; it stays until the arena goes
+    auto grown = std::make_unique<ChunkTable>();
+    grown->size = table == nullptr ? 16 : table->size * 2;
+    grown->chunks = std::make_unique<std::atomic<Node*>[]>(grown->size);
+    for (std::size_t i = 0; i < chunk; ++i) {
+      grown->chunks[i].store(_chunks[i].get(), std::memory_order_relaxed);
     }
-    return _parent->_left->_left;
+    grown->chunks[chunk].store(base, std::memory_order_relaxed);
+    _published.store(grown.get(), std::memory_order_release);
+    _tables.push_back(std::move(grown));
   }
 
-  NodeSPtr _parent{};
-  NodeSPtr _left{};
-  NodeSPtr _right{};
+  std::vector<std::unique_ptr<Node[]>> _chunks;
+  std::vector<std::unique_ptr<ChunkTable>> _tables;
+  std::atomic<ChunkTable*> _published{nullptr};
+  uint32_t _end = 0;
+  uint32_t _free = 0;
+};
 
-  Value _value{};
-  TreeColor _color = TreeColor::RED;
+// how find and findMin synchronize with insert and remove. writers always
+// take the mutex, one at a time.
+enum class ReadMode : uint8_t {
+  // readers take the mutex too, and get a pointer to the stored value
+  Locked,
+  // readers take no lock. they walk the tree under a sequence lock, copying
+  // each value they compare, and start over if a writer ran meanwhile; a
+  // walk longer than any valid tree path also starts over. results are
+  // copies in a std::optional, so Value must be lock-free atomic sized.
+  Optimistic,
 };
 
-template <typename Value, typename Compare = std::less<Value>()>
+namespace detail {
+template <typename Value>
+constexpr bool optimisticReadable() {
+  if constexpr (std::is_trivially_copyable_v<Value>) {
+    return std::atomic_ref<Value>::is_always_lock_free;
+  } else {
+    return false;
+  }
+}
+
+// what the node aligns the value to: atomic_ref's requirement when readers
+// copy it without the lock
+template <typename Value, ReadMode Mode>
+constexpr std::size_t valueAlignment() {
+  if constexpr (Mode == ReadMode::Optimistic) {
+    return std::max(alignof(Value), std::atomic_ref<Value>::required_alignment);
+  } else {
+    return alignof(Value);
+  }
+}
+
+// the key of a map entry
+struct FirstOf {
+  template <typename Pair>
+  const auto& operator()(const Pair& pair) const {
+    return pair.first;
+  }
+};
+
+// like std::map: a comparator with is_transparent compares lookup arguments
+// of any type against the keys, without building a Key for them
+template <typename Compare>
+concept Transparent = requires { typename Compare::is_transparent; };
+template <typename K, typename Key, typename Compare>
+concept LookupKey =
+  Transparent<Compare> || std::is_convertible_v<const K&, Key>;
+
+inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address);
+#else
+  (void)address;
+#endif
+}
+}  // namespace detail
+
+// Ranked keeps subtree sizes in the nodes for select and rank. KeyOf picks
+// the part of a value that Compare orders: the value itself in a set, the
+// first member in an RBMap.
+template <typename Value,
+          typename Compare = std::less<Value>,
+          ReadMode Mode = ReadMode::Locked,
+          bool Ranked = false,
+          typename KeyOf = std::identity>
 class RBTree {
+  static_assert(Mode == ReadMode::Locked ||
+                  detail::optimisticReadable<Value>(),
+                "ReadMode::Optimistic needs a lock-free atomic Value");
+  // the key inside a map value is const, so the value may be handed out
+  // mutable; a set's value is its key and is only handed out const
+  static constexpr bool kIsMap = !std::is_same_v<KeyOf, std::identity>;
+  using ValuePtr = std::conditional_t<kIsMap, Value*, const Value*>;
+
  public:
-  using Node = Node<Value, Compare>;
-  using NodeSPtr = std::shared_ptr<Node>;
-  using NodeUPtr = std::unique_ptr<Node>;
+  using Node =
+    ArenaNode<Value, Ranked, detail::valueAlignment<Value, Mode>()>;
+  using Key = std::remove_cvref_t<std::invoke_result_t<KeyOf, const Value&>>;
+  // what a const find returns
+  using Found = std::conditional_t<Mode == ReadMode::Optimistic,
+                                   std::optional<Value>,
+                                   const Value*>;
+
+  RBTree() = default;
+  RBTree(const RBTree&) = delete;
+  RBTree& operator=(const RBTree&) = delete;
+
+  // builds the tree from ascending values in O(n): each subtree takes the
+  // middle of its span, and the deepest level is red when it is partial.
+  // equal neighbours are kept once.
+  template <std::ranges::input_range Range>
+  static RBTree fromSorted(Range&& values) {
+    return RBTree(FromSorted{}, sortedUnique(std::forward<Range>(values)));
+  }
+
   // TODO() not Value&& or const Value&. Value deal all condition.
   template <typename T>
     requires std::is_convertible_v<T, Value>
   bool insert(T&& value) {
+    LZ_TRACE_SCOPE("rbtree.insert");
     std::lock_guard<std::mutex> lock(_mutex);
     // first insert as nomal BST
-    auto node = insertValue(_root, std::forward<T>(value));
-    if (node == nullptr) {
+    Slot slot = findSlot(_root, keyOf(value));
+    if (slot.existing != kNil) {
       return false;
     }
+    WriteSection section(*this);
     // then rotate or change color to keep balance
-    fixupAfterInsert(node);
+    fixupAfterInsert(link(slot, std::forward<T>(value)));
     return true;
-  };
-  void remove(Value value) {
-    NodeSPtr node = find(value);
+  }
+
+  // builds the value in a fresh node and links it unless its key is there
+  // already, in which case the node goes back to the free list. returns
+  // the stored value, new or old, and whether it is new.
+  template <typename... Args>
+  std::pair<ValuePtr, bool> emplace(Args&&... args) {
     std::lock_guard<std::mutex> lock(_mutex);
-    if (node == nullptr) {
-      return;
+    uint32_t index = _nodes.allocate();
+    try {
+      constructValue(_nodes[index]._value, std::forward<Args>(args)...);
+    } catch (...) {
+      _nodes.release(index);
+      throw;
     }
-    if (_count == 1 && _root->_value == value) {
-      _root = nullptr;
-      --_count;
-      return;
+    Slot slot = findSlot(_root, keyOf(_nodes[index]._value));
+    if (slot.existing != kNil) {
+      drop(index);
+      return {&_nodes[slot.existing]._value, false};
     }
-    // if node has two child, find the max value in left child
-    // and replace node with max value node.
-    if (node->_left && node->_right) {
-      NodeSPtr lower_node = findRightestNode(node->_left);
-      // auto lower_node_parent = lower_node->parent;
-      std::swap(node->_value, lower_node->_value);
-      node = lower_node;
-      // swapNodePtr(lower_node, node);
-    };
+    WriteSection section(*this);
+    attach(slot, index);
+    fixupAfterInsert(index);
+    return {&_nodes[index]._value, true};
+  }
+  // maps: constructs the mapped value from args only if key is not there
+  template <typename... Args>
+  std::pair<Value*, bool> try_emplace(const Key& key, Args&&... args)
+    requires kIsMap
+  {
+    return tryEmplace(key, std::forward<Args>(args)...);
+  }
+  template <typename... Args>
+  std::pair<Value*, bool> try_emplace(Key&& key, Args&&... args)
+    requires kIsMap
+  {
+    return tryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
 
-    // if node has one child, replace node with child. and change color to black
-    // not like front case to exchange value. because child is not leaf node.
-    if (node->_left || node->_right) {
-      auto child = node->_left ? node->_left : node->_right;
-      auto parent = node->_parent;
-
-      // edge case
-      if (parent == nullptr) [[unlikely]] {
-        _root = child;
-        _root->_parent = nullptr;
-        _root->_color = TreeColor::BLACK;
-        --_count;
-        return;
-      }
-      if (parent->_left == node) {
-        parent->_left = child;
-      } else {
-        parent->_right = child;
+  // inserts every value under one lock and returns how many were new. the
+  // batch is sorted first. a batch of at least 1/kRebuildRatio of the tree
+  // is merged with it and the tree rebuilt in O(n + k); a smaller one is
+  // inserted in order, each search starting from the previous insertion
+  // point instead of the root. map values cannot be sorted in place, so
+  // maps build with fromSorted instead.
+  template <std::ranges::input_range Range>
+  std::size_t insertBatch(Range&& values)
+    requires std::is_move_assignable_v<Value>
+  {
+    std::vector<Value> batch;
+    if constexpr (std::ranges::sized_range<Range>) {
+      batch.reserve(std::ranges::size(values));
+    }
+    std::ranges::copy(values, std::back_inserter(batch));
+    std::sort(batch.begin(), batch.end(), less());
+    batch.erase(std::unique(batch.begin(), batch.end(), equivalent()),
+                batch.end());
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (batch.empty()) {
+      return 0;
+    }
+    WriteSection section(*this);
+    if (batch.size() * kRebuildRatio >= _count) {
+      return rebuildWith(std::move(batch));
+    }
+    std::size_t inserted = 0;
+    uint32_t finger = kNil;
+    for (auto& value : batch) {
+      const Key& key = keyOf(value);
+      Slot slot = findSlot(climb(finger, key), key);
+      if (slot.existing != kNil) {
+        finger = slot.existing;
+        continue;
       }
-      child->_parent = parent;
-      child->_color = TreeColor::BLACK;
-      --_count;
-      return;
+      finger = link(slot, std::move(value));
+      fixupAfterInsert(finger);
+      ++inserted;
     }
-    // if node is red leaf node. just remove it.
-    if (node->_color == TreeColor::RED) {
-      if (node->_parent->_left == node) {
-        node->_parent->_left = nullptr;
-      } else {
-        node->_parent->_right = nullptr;
+    return inserted;
+  }
+
+  // returns false if the key was not in the tree
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  bool remove(const K& key) {
+    LZ_TRACE_SCOPE("rbtree.remove");
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t node = locate(asKey(key));
+    if (node == kNil) {
+      return false;
+    }
+    WriteSection section(*this);
+    unlink(node);
+    drop(node);
+    return true;
+  }
+
+  // owns a node that extract took out of the tree, value and all, until it
+  // is inserted again or dropped. the value stays where it is, so a
+  // delete-reinsert cycle neither allocates nor copies it. like a find
+  // pointer it must not outlive the tree. Locked mode only: the value may
+  // be changed while out of the tree, unseen by optimistic readers.
+  class node_type {
+   public:
+    node_type() = default;
+    node_type(node_type&& other) noexcept
+      : _tree(std::exchange(other._tree, nullptr)),
+        _node(std::exchange(other._node, kNil)),
+        _value(std::exchange(other._value, nullptr)) {
+    }
+    node_type& operator=(node_type&& other) noexcept {
+      if (this != &other) {
+        reset();
+        _tree = std::exchange(other._tree, nullptr);
+        _node = std::exchange(other._node, kNil);
+        _value = std::exchange(other._value, nullptr);
       }
-      --_count;
-      return;
+      return *this;
     }
-    // if node is black leaf node
-    removeBlackLeafNode(node);
-    // edge case
-    if (node == _root) [[unlikely]] {
-      --_count;
-      _root = nullptr;
-      return;
+    ~node_type() {
+      reset();
     }
-    if (node->_parent->_left == node) {
-      node->_parent->_left = nullptr;
-    } else {
-      node->_parent->_right = nullptr;
+
+    bool empty() const {
+      return _node == kNil;
+    }
+    explicit operator bool() const {
+      return !empty();
+    }
+    // sets: the value, which may be changed before it goes back in
+    Value& value() const
+      requires(!kIsMap)
+    {
+      return *_value;
+    }
+    const Key& key() const
+      requires kIsMap
+    {
+      return _value->first;
+    }
+    auto& mapped() const
+      requires kIsMap
+    {
+      return _value->second;
+    }
+    // maps: moves the mapped value under another key
+    template <typename K>
+    void setKey(K&& key)
+      requires kIsMap
+    {
+      auto mapped = std::move(_value->second);
+      constructValue(*_value, std::forward<K>(key), std::move(mapped));
     }
 
-    --_count;
+   private:
+    friend class RBTree;
+    node_type(RBTree* tree, uint32_t node)
+      : _tree(tree), _node(node), _value(&tree->_nodes[node]._value) {
+    }
+    void reset() {
+      if (_node != kNil) {
+        std::lock_guard<std::mutex> lock(_tree->_mutex);
+        _tree->drop(_node);
+        _node = kNil;
+      }
+    }
+
+    RBTree* _tree = nullptr;
+    uint32_t _node = kNil;
+    // cached: the chunk table may grow under another thread
+    Value* _value = nullptr;
+  };
+
+  // unlinks the node holding key and hands it over; empty if there is none
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare> &&
+             (Mode == ReadMode::Locked)
+  node_type extract(const K& key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t node = locate(asKey(key));
+    if (node == kNil) {
+      return {};
+    }
+    unlink(node);
+    return node_type(this, node);
+  }
+  // links an extracted node back in. returns false, leaving the node in the
+  // handle, if its key is already there. a node from another tree cannot
+  // move arenas, so its value is moved into a new node here.
+  bool insert(node_type&& handle)
+    requires(Mode == ReadMode::Locked)
+  {
+    if (handle.empty()) {
+      return false;
+    }
+    if (handle._tree != this) {
+      if (!insert(std::move(*handle._value))) {
+        return false;
+      }
+      handle.reset();
+      return true;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    Slot slot = findSlot(_root, keyOf(*handle._value));
+    if (slot.existing != kNil) {
+      return false;
+    }
+    uint32_t node = std::exchange(handle._node, kNil);
+    attach(slot, node);
+    fixupAfterInsert(node);
+    return true;
   }
 
-  NodeSPtr find(Value value) {
+  // Locked: the stored value, or nullptr; it stays valid until that value
+  // is removed. Optimistic: a copy, or std::nullopt.
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  auto find(const K& key) const {
+    LZ_TRACE_SCOPE("rbtree.find");
+    if constexpr (Mode == ReadMode::Optimistic) {
+      const auto& k = asKey(key);
+      return optimisticWalk(
+        [&](const Node& node, const Value& cur, std::optional<Value>& found) {
+          if (_compare(k, keyOf(cur))) {
+            return static_cast<uint32_t>(node._left);
+          }
+          if (_compare(keyOf(cur), k)) {
+            return static_cast<uint32_t>(node._right);
+          }
+          found = cur;
+          return kNil;
+        });
+    } else {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return result(locate(asKey(key)));
+    }
+  }
+  // maps: the entry, whose mapped value may be changed in place
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare> && kIsMap
+  Value* find(const K& key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t node = locate(asKey(key));
+    return node == kNil ? nullptr : &_nodes[node]._value;
+  }
+  // out[i] = find(keys[i]) for every i, returning how many were found.
+  // kBatchLanes lookups advance in turn, one level each, and each
+  // prefetches the child it goes to next, so their cache misses overlap
+  // instead of following one another. a lane that finishes takes the next
+  // key. the lock is held throughout, in either mode. keys of another type
+  // than Key need a transparent Compare, as they are not converted.
+  template <typename K = Key>
+    requires std::is_same_v<K, Key> || detail::Transparent<Compare>
+  std::size_t findBatch(std::span<const std::type_identity_t<K>> keys,
+                        std::span<Found> out) const {
+    LZ_TRACE_SCOPE("rbtree.findBatch");
+    if (out.size() < keys.size()) {
+      throw std::invalid_argument("rbtree: findBatch out too small");
+    }
     std::lock_guard<std::mutex> lock(_mutex);
-    NodeSPtr node = _root;
-    while (node) {
-      if (value < node->_value) {
-        node = node->_left;
-      } else if (value > node->_value) {
-        node = node->_right;
+    uint32_t node[kBatchLanes];
+    std::size_t slot[kBatchLanes];
+    std::size_t live = std::min(kBatchLanes, keys.size());
+    std::size_t next = live;
+    for (std::size_t lane = 0; lane < live; ++lane) {
+      node[lane] = _root;
+      slot[lane] = lane;
+    }
+    std::size_t found = 0;
+    for (std::size_t lane = 0; live > 0;) {
+      if (lane >= live) {
+        lane = 0;
+      }
+      uint32_t cur = node[lane];
+      if (cur != kNil) {
+        const K& key = keys[slot[lane]];
+        const Node& n = _nodes[cur];
+        uint32_t child = kNil;
+        if (_compare(key, keyOf(n._value))) {
+          child = n._left;
+        } else if (_compare(keyOf(n._value), key)) {
+          child = n._right;
+        } else {
+          child = cur;  // found: settled below
+        }
+        if (child != cur) {
+          detail::prefetch(&_nodes[child]);
+          node[lane++] = child;
+          continue;
+        }
+      }
+      out[slot[lane]] = result(cur);
+      found += cur != kNil;
+      if (next < keys.size()) {
+        node[lane] = _root;  // the top levels stay cached
+        slot[lane++] = next++;
       } else {
-        return node;
+        --live;
+        node[lane] = node[live];
+        slot[lane] = slot[live];
       }
     }
-    return nullptr;
-  };
-  NodeSPtr findMin() {
+    return found;
+  }
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  bool contains(const K& key) const {
     std::lock_guard<std::mutex> lock(_mutex);
-    return findLeftestNode(_root);
+    return locate(asKey(key)) != kNil;
+  }
+  auto findMin() const {
+    if constexpr (Mode == ReadMode::Optimistic) {
+      return optimisticWalk(
+        [](const Node& node, const Value& cur, std::optional<Value>& found) {
+          found = cur;
+          return static_cast<uint32_t>(node._left);
+        });
+    } else {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _root == kNil ? nullptr
+                           : &_nodes[findLeftestNode(_root)]._value;
+    }
+  }
+  // in-order traversal by parent links: no stack, no allocation. like the
+  // pointers find returns, an iterator stays valid until its value is
+  // removed, but stepping it must not race with a writer, in either mode.
+  class const_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Value*;
+    using reference = const Value&;
+
+    const_iterator() = default;
+
+    reference operator*() const {
+      return _tree->_nodes[_node]._value;
+    }
+    pointer operator->() const {
+      return &**this;
+    }
+    const_iterator& operator++() {
+      _node = _tree->successor(_node);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto old = *this;
+      ++*this;
+      return old;
+    }
+    // --end() is the largest value
+    const_iterator& operator--() {
+      _node = _node == kNil ? _tree->findRightestNode(_tree->_root)
+                            : _tree->predecessor(_node);
+      return *this;
+    }
+    const_iterator operator--(int) {
+      auto old = *this;
+      --*this;
+      return old;
+    }
+    bool operator==(const const_iterator& other) const {
+      return _node == other._node;
+    }
+
+   private:
+    friend class RBTree;
+    const_iterator(const RBTree* tree, uint32_t node)
+      : _tree(tree), _node(node) {
+    }
+
+    const RBTree* _tree = nullptr;
+    uint32_t _node = kNil;
   };
-  std::size_t size() const {
+  // values are the keys, so there is nothing to modify through an iterator
+  using iterator = const_iterator;
+
+  const_iterator begin() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return {this, _root == kNil ? kNil : findLeftestNode(_root)};
+  }
+  const_iterator end() const {
+    return {this, kNil};
+  }
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  const_iterator lower_bound(const K& key) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return {this, bound<false>(asKey(key))};
+  }
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  const_iterator upper_bound(const K& key) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return {this, bound<true>(asKey(key))};
+  }
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  std::pair<const_iterator, const_iterator> equal_range(const K& key) const {
+    const auto& k = asKey(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    return {{this, bound<false>(k)}, {this, bound<true>(k)}};
+  }
+
+  // func(value) for every value with a key in [lo, hi), ascending, under
+  // the lock: func must not modify the tree. returns how many values were
+  // visited.
+  template <typename K = Key, typename Func>
+    requires detail::LookupKey<K, Key, Compare>
+  std::size_t for_each_in_range(const K& lo, const K& hi, Func&& func) const {
+    const auto& end = asKey(hi);
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::size_t visited = 0;
+    for (uint32_t node = bound<false>(asKey(lo));
+         node != kNil && _compare(keyOf(_nodes[node]._value), end);
+         node = successor(node)) {
+      func(_nodes[node]._value);
+      ++visited;
+    }
+    return visited;
+  }
+  // func(value) for every value, ascending, under the lock
+  template <typename Func>
+  std::size_t for_each(Func&& func) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    forEachNode(_root, [&](uint32_t node) { func(_nodes[node]._value); });
     return _count;
   }
-  NodeSPtr root() const {
-    return _root;
+
+  // set operations with other, by divide and conquer on split and join
+  // (Blelloch, Ferizovic and Sun, "Just join for parallel ordered sets").
+  // other's values are copied into this arena as a tree of their own, in
+  // O(m); then this tree is split around other's root, both halves are
+  // combined recursively, and the results joined under that root, relinking
+  // nodes without allocating. that is O(m log(n / m + 1)) comparisons, and
+  // up to `threads` threads take the two halves in parallel. on equal keys
+  // this tree's value is kept. unionWith returns how many values were
+  // added, the others how many were removed.
+  std::size_t unionWith(const RBTree& other, unsigned threads = 1) {
+    return combine<SetOp::Union>(other, threads);
   }
-  std::pair<bool, int> checkRbTree() {
-    auto count = checkEachPath(_root, 0);
-    return count == -1 ? std::make_pair(false, count)
-                       : std::make_pair(true, count);
+  std::size_t intersectWith(const RBTree& other, unsigned threads = 1) {
+    return combine<SetOp::Intersection>(other, threads);
   }
-  void printTree(NodeSPtr node = nullptr,
-                 int level = 0,
-                 const std::string& prefix = "Root: ") {
-    if (_root == nullptr) {
-      return;
+  std::size_t differenceWith(const RBTree& other, unsigned threads = 1) {
+    return combine<SetOp::Difference>(other, threads);
+  }
+
+  // moves the values with keys not less than key into a new tree. the split
+  // itself is O(log n); the moved values are copied into the new tree's
+  // arena, so the whole is O(log n + k) for k moved values.
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  RBTree split(const K& key) {
+    std::vector<Value> moved;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      WriteSection section(*this);
+      Split parts = splitAt(Sub{_root, blackHeight(_root)}, asKey(key));
+      if (parts.match != kNil) {
+        parts.right = join(Sub{}, parts.match, parts.right);
+      }
+      moved.reserve(_count);
+      Garbage garbage;
+      if (parts.right.root != kNil) {
+        _nodes[parts.right.root].setParent(kNil);  // where the walk ends
+      }
+      forEachNode(parts.right.root, [&](uint32_t node) {
+        moved.push_back(std::move(_nodes[node]._value));
+        discard(garbage, node);
+      });
+      release(garbage);
+      setRoot(parts.left.root);
+      _count -= moved.size();
     }
-    if (node == nullptr) {
-      node = _root;
+    return RBTree(FromSorted{}, std::move(moved));
+  }
+  // appends key and then every value of right, leaving right empty. every
+  // key here must be less than key, and key less than every key of right,
+  // or std::invalid_argument is thrown and nothing changes. the join is
+  // O(log n) after right's values are copied into this arena.
+  void join(Value key, RBTree& right) {
+    if (&right == this) {
+      throw std::invalid_argument("rbtree: join with itself");
+    }
+    std::scoped_lock lock(_mutex, right._mutex);
+    if ((_root != kNil &&
+         !_compare(keyOf(_nodes[findRightestNode(_root)]._value),
+                   keyOf(key))) ||
+        (right._root != kNil &&
+         !_compare(keyOf(key),
+                   keyOf(right._nodes[right.findLeftestNode(right._root)]
+                           ._value)))) {
+      throw std::invalid_argument("rbtree: join keys out of order");
     }
+    WriteSection section(*this);
+    Sub rest = adopt(right);
+    uint32_t middle = _nodes.allocate();
+    constructValue(_nodes[middle]._value, std::move(key));
+    setRoot(join(Sub{_root, blackHeight(_root)}, middle, rest).root);
+    _count += right._count + 1;
+    WriteSection rightSection(right);
+    right.clearLocked();
+  }
 
-    std::cout << std::setw(level * 4) << prefix << node->_value
-              << (node->_color == TreeColor::RED ? "(R)" : "(B)") << std::endl;
-    if (node->_left != nullptr || node->_right != nullptr) {
-      if (node->_left) {
-        printTree(node->_left, level + 1, "L--- ");
+  // the k-th smallest value, from 0, in O(log n); select(p * (size() - 1))
+  // is the p-quantile. returns like find.
+  auto select(std::size_t k) const
+    requires Ranked
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t node = _root;
+    while (node != kNil) {
+      std::size_t left = _nodes[_nodes[node]._left]._size;
+      if (k == left) {
+        break;
+      }
+      if (k < left) {
+        node = _nodes[node]._left;
       } else {
-        std::cout << std::setw((level + 1) * 4) << "L--- " << "None"
-                  << std::endl;
+        k -= left + 1;
+        node = _nodes[node]._right;
       }
-      if (node->_right) {
-        printTree(node->_right, level + 1, "R--- ");
+    }
+    return result(node);
+  }
+  // how many values have a key less than key, in O(log n)
+  template <typename K = Key>
+    requires detail::LookupKey<K, Key, Compare>
+  std::size_t rank(const K& key) const
+    requires Ranked
+  {
+    const auto& k = asKey(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::size_t less = 0;
+    uint32_t node = _root;
+    while (node != kNil) {
+      if (_compare(keyOf(_nodes[node]._value), k)) {
+        less += _nodes[_nodes[node]._left]._size + 1;
+        node = _nodes[node]._right;
       } else {
-        std::cout << std::setw((level + 1) * 4) << "R--- " << "None"
-                  << std::endl;
+        node = _nodes[node]._left;
       }
     }
+    return less;
   }
 
- private:
-  //     [3]                   4
-  //  1      4      ==>    3      5
-  //       2   5        1    2       6
-  //             6
-  void rotateLeft(NodeSPtr node) {
-    NodeSPtr parent = node->_parent;
-    NodeSPtr rightNode = node->_right;
-    NodeSPtr successor = node->_right->_left;
+  std::size_t size() const {
+    return _count;
+  }
+  bool empty() const {
+    return _count == 0;
+  }
+  // bytes the nodes take, for comparing layouts
+  std::size_t bytes() const {
+    return _nodes.bytes();
+  }
 
-    rightNode->_left = node;
-    node->_right = successor;
+  // (valid, black height of every path)
+  std::pair<bool, int> checkRbTree() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (color(_root) != TreeColor::BLACK) {
+      return {false, -1};
+    }
+    auto count = checkEachPath(_root, kNil, 0);
+    return {count != -1, count};
+  }
+  void printTree() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_root != kNil) {
+      printNode(_root, 0, "Root: ");
+    }
+  }
 
-    rightNode->_parent = node->_parent;
-    node->_parent = rightNode;
+ private:
+  static constexpr uint32_t kNil = 0;
+  static constexpr std::size_t kRebuildRatio = 16;
+  // lookups in flight in findBatch: enough misses to keep the memory system
+  // busy, within what a core tracks at once (10 to 20 line fill buffers)
+  static constexpr std::size_t kBatchLanes = 16;
+  // longer than any path in a valid tree of 2^31 nodes
+  static constexpr int kMaxDepth = 64;
 
-    if (successor) {
-      successor->_parent = node;
+  // marks a modification for optimistic readers: the sequence is odd while
+  // the tree may be inconsistent
+  class WriteSection {
+   public:
+    explicit WriteSection(RBTree& tree) : _tree(tree) {
+      if constexpr (Mode == ReadMode::Optimistic) {
+        auto seq = _tree._seq.load(std::memory_order_relaxed);
+        _tree._seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+      }
     }
-    if (parent) {
-      if (node == parent->_left) {
-        parent->_left = rightNode;
-      } else {
-        parent->_right = rightNode;
+    ~WriteSection() {
+      if constexpr (Mode == ReadMode::Optimistic) {
+        auto seq = _tree._seq.load(std::memory_order_relaxed);
+        _tree._seq.store(seq + 1, std::memory_order_release);
       }
     }
-    if (node == _root) {
-      _root = rightNode;
+
+   private:
+    RBTree& _tree;
+  };
+
+  // walks down from the root: step(node, copy of its value, result) picks
+  // the next index, kNil to stop. retried until no writer overlapped.
+  template <typename Step>
+  std::optional<Value> optimisticWalk(Step step) const {
+    for (;;) {
+      auto seq = _seq.load(std::memory_order_acquire);
+      if (seq & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::optional<Value> result;
+      uint32_t node = _root;
+      int depth = 0;
+      bool torn = false;
+      while (node != kNil) {
+        const Node* cur = _nodes.tryGet(node);
+        if (cur == nullptr || ++depth > kMaxDepth) {
+          torn = true;
+          break;
+        }
+        Value value = std::atomic_ref<Value>(const_cast<Value&>(cur->_value))
+                        .load(std::memory_order_relaxed);
+        node = step(*cur, value, result);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!torn && _seq.load(std::memory_order_relaxed) == seq) {
+        return result;
+      }
     }
   }
-  //         [5]                    3
-  //       3      6     ==>      2      5
-  //    2    4                1      4     6
-  // 1
-  // dual operation of rotateLeft. just swap text "right" with "left"
-  void rotateRight(NodeSPtr node) {
-    NodeSPtr parent = node->_parent;
-    NodeSPtr leftNode = node->_left;
-    NodeSPtr successor = node->_left->_right;
 
-    // update node's child
-    leftNode->_right = node;
-    node->_left = successor;
+  TreeColor color(uint32_t node) const {
+    return _nodes[node].color();
+  }
 
-    // update node's parent
-    leftNode->_parent = node->_parent;
-    node->_parent = leftNode;
+  // what a lookup that ends at node returns in this mode
+  auto result(uint32_t node) const {
+    if constexpr (Mode == ReadMode::Optimistic) {
+      return node == kNil ? std::nullopt
+                          : std::optional<Value>(_nodes[node]._value);
+    } else {
+      return node == kNil ? nullptr : &_nodes[node]._value;
+    }
+  }
 
-    if (successor) {
-      successor->_parent = node;
+  // recomputes node's subtree size from its children
+  void resize(uint32_t node) {
+    if constexpr (Ranked) {
+      _nodes[node]._size = _nodes[_nodes[node]._left]._size +
+                           _nodes[_nodes[node]._right]._size + 1;
     }
-    if (parent) {
-      if (node == parent->_right) {
-        parent->_right = leftNode;
-      } else {
-        parent->_left = leftNode;
+  }
+  // adds delta to the size of node and of every ancestor
+  void resizePath(uint32_t node, int delta) {
+    if constexpr (Ranked) {
+      for (; node != kNil; node = _nodes[node].parent()) {
+        _nodes[node]._size += delta;
       }
     }
-    if (node == _root) {
-      _root = leftNode;
+  }
+
+  template <typename V>
+  static decltype(auto) keyOf(const V& value) {
+    return KeyOf{}(value);
+  }
+  // a lookup argument as the comparator will take it: as it is when
+  // Compare is transparent, otherwise converted to a Key once up front
+  // rather than on every comparison
+  template <typename K>
+  static decltype(auto) asKey(const K& key) {
+    if constexpr (detail::Transparent<Compare> || std::is_same_v<K, Key>) {
+      return (key);
+    } else {
+      return Key(key);
     }
   }
-  //        G(b)                G(r)
-  //     P(r)  U(r)   ===>    P(b)  U(b)
-  //   N(r)                 N(r)
-  void recolor(NodeSPtr node) {
-    assert(node != nullptr);
+  // orders and matches whole values by their keys
+  auto less() const {
+    return [this](const Value& a, const Value& b) {
+      return _compare(keyOf(a), keyOf(b));
+    };
+  }
+  auto equivalent() const {
+    return [this](const Value& a, const Value& b) {
+      return !_compare(keyOf(a), keyOf(b)) && !_compare(keyOf(b), keyOf(a));
+    };
+  }
 
-    // recolor(node->_parent->_parent);
+  // replaces the value in place, so map values with their const keys can
+  // be rebuilt. if construction throws, value is left default-constructed.
+  template <typename... Args>
+  static void constructValue(Value& value, Args&&... args) {
+    if constexpr (Mode == ReadMode::Optimistic) {
+      std::atomic_ref<Value>(value).store(Value(std::forward<Args>(args)...),
+                                          std::memory_order_relaxed);
+    } else {
+      std::destroy_at(&value);
+      try {
+        std::construct_at(&value, std::forward<Args>(args)...);
+      } catch (...) {
+        std::construct_at(&value);
+        throw;
+      }
+    }
   }
-  template <typename T>
-  NodeSPtr insertValue(NodeSPtr node, T&& value) {
-    if (node == nullptr) {
-      _root = std::make_shared<Node>(value);
-      ++_count;
-      return _root;
-    }
-    while (node) {
-      if (value < node->_value) {
-        if (node->_left == nullptr) {
-          node->_left = std::make_shared<Node>(value);
-          node->_left->_parent = node;
-          ++_count;
-          return node->_left;
-        }
-        node = node->_left;
-      } else if (value > node->_value) {
-        if (node->_right == nullptr) {
-          node->_right = std::make_shared<Node>(value);
-          node->_right->_parent = node;
-          ++_count;
-          return node->_right;
-        }
-        node = node->_right;
+
+  // where key goes below `from` (the root if kNil): its would-be parent
+  // and side, or the node that already holds it
+  struct Slot {
+    uint32_t parent = kNil;
+    bool left = false;
+    uint32_t existing = kNil;
+  };
+  template <typename K>
+  Slot findSlot(uint32_t from, const K& key) const {
+    Slot slot;
+    uint32_t cur = from == kNil ? static_cast<uint32_t>(_root) : from;
+    while (cur != kNil) {
+      slot.parent = cur;
+      if (_compare(key, keyOf(_nodes[cur]._value))) {
+        cur = _nodes[cur]._left;
+        slot.left = true;
+      } else if (_compare(keyOf(_nodes[cur]._value), key)) {
+        cur = _nodes[cur]._right;
+        slot.left = false;
       } else {
-        return nullptr;
+        slot.existing = cur;
+        return slot;
       }
     }
-    // should not reach here
-    return nullptr;
+    return slot;
   }
-  NodeSPtr findRightestNode(NodeSPtr node) const {
-    if (node == nullptr) [[unlikely]] {
-      return nullptr;
+
+  // hangs a new red node holding value at slot; the caller fixes colors
+  template <typename T>
+  uint32_t link(const Slot& slot, T&& value) {
+    uint32_t index = _nodes.allocate();
+    constructValue(_nodes[index]._value, std::forward<T>(value));
+    attach(slot, index);
+    return index;
+  }
+  // hangs an allocated node, red, at slot
+  void attach(const Slot& slot, uint32_t index) {
+    Node& node = _nodes[index];
+    node._left = kNil;
+    node._right = kNil;
+    node._parentColor =
+      slot.parent << 1 | static_cast<uint32_t>(TreeColor::RED);
+    if constexpr (Ranked) {
+      node._size = 1;
     }
-    while (node->_right) {
-      node = node->_right;
+    if (slot.parent == kNil) {
+      _root = index;
+    } else if (slot.left) {
+      _nodes[slot.parent]._left = index;
+    } else {
+      _nodes[slot.parent]._right = index;
     }
-    return node;
+    ++_count;
+    resizePath(slot.parent, 1);
   }
-  NodeSPtr findLeftestNode(NodeSPtr node) const {
-    if (node == nullptr) [[unlikely]] {
-      return nullptr;
+  // frees a node that is not in the tree, dropping its value
+  void drop(uint32_t index) {
+    if constexpr (!std::is_trivially_copyable_v<Value>) {
+      constructValue(_nodes[index]._value);
     }
-    while (node->_left) {
-      node = node->_left;
+    _nodes.release(index);
+  }
+
+  template <typename K, typename... Args>
+  std::pair<Value*, bool> tryEmplace(K&& key, Args&&... args) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Slot slot = findSlot(_root, key);
+    if (slot.existing != kNil) {
+      return {&_nodes[slot.existing]._value, false};
     }
-    return node;
+    uint32_t index = _nodes.allocate();
+    try {
+      constructValue(_nodes[index]._value,
+                     std::piecewise_construct,
+                     std::forward_as_tuple(std::forward<K>(key)),
+                     std::forward_as_tuple(std::forward<Args>(args)...));
+    } catch (...) {
+      _nodes.release(index);
+      throw;
+    }
+    WriteSection section(*this);
+    attach(slot, index);
+    fixupAfterInsert(index);
+    return {&_nodes[index]._value, true};
   }
-  void removeBlackLeafNode(NodeSPtr node) {
-    if (node == _root) {
-      return;
+
+  // for ascending inserts: the lowest ancestor of finger (the previous
+  // insertion) whose subtree must contain key, or kNil for the root.
+  // finger < key, so any ancestor with key below its own qualifies.
+  uint32_t climb(uint32_t finger, const Key& key) const {
+    while (finger != kNil && !_compare(key, keyOf(_nodes[finger]._value))) {
+      finger = _nodes[finger].parent();
     }
-    auto parent = node->_parent;
-    auto sibling = node->sibling();
-
-    // Case 1: Sibling is RED, parent and nephews must be BLACK
-    //   Step 1. If N is a left child, left rotate P;
-    //           If N is a right child, right rotate P.
-    //   Step 2. Paint S to BLACK, P to RED
-    //   Step 3. Goto Case 2, 3, 4, 5
-    //      [P]                   <S>               [S]
-    //      / \    l-rotate(P)    / \    repaint    / \
-    //    [N] <S>  ==========>  [P] [D]  ======>  <P> [D]
-    //        / \               / \               /  \
-    //      [C] [D]           [N] [C]           [N] [C]
-    if (sibling->_color == TreeColor::RED) {
-      if (node == parent->_left) {
-        rotateLeft(parent);
-      } else {
-        rotateRight(parent);
+    return finger;
+  }
+
+  template <typename Range>
+  static std::vector<Value> sortedUnique(Range&& values) {
+    std::vector<Value> result;
+    if constexpr (std::ranges::sized_range<Range>) {
+      result.reserve(std::ranges::size(values));
+    }
+    Compare compare{};
+    for (auto&& value : values) {
+      assert(result.empty() || !compare(keyOf(value), keyOf(result.back())));
+      if (result.empty() || compare(keyOf(result.back()), keyOf(value))) {
+        result.emplace_back(std::forward<decltype(value)>(value));
       }
-      sibling->_color = TreeColor::BLACK;
-      parent->_color = TreeColor::RED;
-      sibling = node->sibling();
-    }
-
-    // Case 2: Sibling and nephews are BLACK, parent is RED
-    //   Swap the color of P and S
-    //      <P>             [P]
-    //      / \             / \
-    //    [N] [S]  ====>  [N] <S>
-    //        / \             / \
-    //      [C] [D]         [C] [D]
-    if (parent->_color == TreeColor::RED &&
-        sibling->_color == TreeColor::BLACK &&
-        (sibling->_left == nullptr ||
-         sibling->_left->_color == TreeColor::BLACK) &&
-        (sibling->_right == nullptr ||
-         sibling->_right->_color == TreeColor::BLACK)) {
-      parent->_color = TreeColor::BLACK;
-      sibling->_color = TreeColor::RED;
-      return;
     }
+    return result;
+  }
+
+  struct FromSorted {};
+  RBTree(FromSorted, std::vector<Value> values) {
+    build(values);
+  }
 
-    // Case 3: Sibling, parent and nephews are all black
-    //   Step 1. Paint S to RED
-    //   Step 2. Recursively maintain P
-    //      [P]             [P]
-    //      / \             / \
-    //    [N] [S]  ====>  [N] <S>
-    //        / \             / \
-    //      [C] [D]         [C] [D]
-
-    if (parent->_color == TreeColor::BLACK &&
-        sibling->_color == TreeColor::BLACK &&
-        (sibling->_left == nullptr ||
-         sibling->_left->_color == TreeColor::BLACK) &&
-        (sibling->_right == nullptr ||
-         sibling->_right->_color == TreeColor::BLACK)) {
-      sibling->_color = TreeColor::RED;
-      removeBlackLeafNode(parent);
+  // replaces the contents with values, ascending and unique
+  void build(std::vector<Value>& values) {
+    _count = values.size();
+    if (values.empty()) {
+      _root = kNil;
       return;
     }
-    // Case 4: Sibling is BLACK, close nephew is RED,
-    //         distant nephew is BLACK
-    //   Step 1. If N is a left child, right rotate S;
-    //           If N is a right child, left rotate S.
-    //   Step 2. Swap the color of close nephew and sibling
-    //   Step 3. Goto case 5
-    //                            {P}                {P}
-    //      {P}                   / \                / \
-    //      / \    r-rotate(S)  [N] <C>   repaint  [N] [C]
-    //    [N] [S]  ==========>        \   ======>        \
-    //        / \                     [S]                <S>
-    //      <C> [D]                     \                  \
-    //                                  [D]                [D]
-
-    auto closeNephew = node->closestNephew();
-    auto distantNephew = node->distantNephew();
-    if (sibling->_color == TreeColor::BLACK &&
-        (closeNephew && closeNephew->_color == TreeColor::RED) &&
-        (distantNephew == nullptr ||
-         distantNephew->_color == TreeColor::BLACK)) {
-      if (node == parent->_left) {
-        rotateRight(sibling);
+    int redDepth = std::bit_width(values.size()) - 1;
+    _root = buildSpan(values, 0, values.size(), kNil, 0, redDepth);
+  }
+  uint32_t buildSpan(std::vector<Value>& values,
+                     std::size_t begin,
+                     std::size_t end,
+                     uint32_t parent,
+                     int depth,
+                     int redDepth) {
+    if (begin == end) {
+      return kNil;
+    }
+    std::size_t mid = begin + (end - begin) / 2;
+    uint32_t index = _nodes.allocate();
+    constructValue(_nodes[index]._value, std::move(values[mid]));
+    auto color = depth == redDepth && depth > 0 ? TreeColor::RED
+                                                : TreeColor::BLACK;
+    _nodes[index]._parentColor = parent << 1 | static_cast<uint32_t>(color);
+    _nodes[index]._left =
+      buildSpan(values, begin, mid, index, depth + 1, redDepth);
+    _nodes[index]._right =
+      buildSpan(values, mid + 1, end, index, depth + 1, redDepth);
+    resize(index);
+    return index;
+  }
+
+  // merges the tree's values with batch, frees every node and builds anew
+  std::size_t rebuildWith(std::vector<Value> batch) {
+    std::vector<Value> merged;
+    merged.reserve(_count + batch.size());
+    std::vector<uint32_t> nodes;
+    nodes.reserve(_count);
+    auto next = batch.begin();
+    forEachNode(_root, [&](uint32_t node) {
+      nodes.push_back(node);
+      Value& value = _nodes[node]._value;
+      while (next != batch.end() && _compare(keyOf(*next), keyOf(value))) {
+        merged.push_back(std::move(*next++));
+      }
+      if (next != batch.end() && !_compare(keyOf(value), keyOf(*next))) {
+        ++next;  // already in the tree
+      }
+      merged.push_back(std::move(value));
+    });
+    std::move(next, batch.end(), std::back_inserter(merged));
+
+    std::size_t inserted = merged.size() - _count;
+    for (uint32_t node : nodes) {
+      drop(node);
+    }
+    build(merged);
+    return inserted;
+  }
+
+  // a detached subtree and its black height: the black nodes on a path
+  // down from its root, nil not counted. its root's parent link is stale
+  // until it is hung somewhere.
+  struct Sub {
+    uint32_t root = kNil;
+    int height = 0;
+  };
+  struct Split {
+    Sub left;
+    uint32_t match = kNil;
+    Sub right;
+  };
+  // nodes dropped by a set operation, chained through _left like the free
+  // list, so tasks collect them without allocating
+  struct Garbage {
+    uint32_t head = kNil;
+    uint32_t tail = kNil;
+    std::size_t count = 0;
+  };
+  enum class SetOp { Union, Intersection, Difference };
+  // below this black height (some 2^8 nodes) a set operation stays on one
+  // thread
+  static constexpr int kForkHeight = 8;
+
+  int blackHeight(uint32_t node) const {
+    int height = 0;
+    for (; node != kNil; node = _nodes[node]._left) {
+      height += color(node) == TreeColor::BLACK;
+    }
+    return height;
+  }
+  Sub child(Sub sub, bool left) const {
+    const Node& node = _nodes[sub.root];
+    return {left ? node._left : node._right,
+            sub.height - (node.color() == TreeColor::BLACK)};
+  }
+  // never writes the nil sentinel, which other threads may be reading
+  void setChildren(uint32_t node, uint32_t left, uint32_t right) {
+    _nodes[node]._left = left;
+    _nodes[node]._right = right;
+    if (left != kNil) {
+      _nodes[left].setParent(node);
+    }
+    if (right != kNil) {
+      _nodes[right].setParent(node);
+    }
+    resize(node);
+  }
+  void setRoot(uint32_t root) {
+    _root = root;
+    if (root != kNil) {
+      _nodes[root].setParent(kNil);
+      _nodes[root].setColor(TreeColor::BLACK);
+    }
+  }
+
+  // join: the tree of l, then node k, then r, where l's keys < k's < r's.
+  // the shorter tree hangs as k's sibling-to-be at the same black height
+  // on the taller one's spine; red k may then sit under a red node, which
+  // one rotation on the way up repairs. O(difference of heights).
+  Sub join(Sub l, uint32_t k, Sub r) {
+    for (Sub* sub : {&l, &r}) {
+      if (color(sub->root) == TreeColor::RED) {
+        _nodes[sub->root].setColor(TreeColor::BLACK);
+        ++sub->height;
+      }
+    }
+    if (l.height == r.height) {
+      setChildren(k, l.root, r.root);
+      _nodes[k].setColor(TreeColor::RED);
+      return {k, l.height};
+    }
+    bool right = l.height > r.height;
+    Sub joined = right ? Sub{joinSpine<true>(l, k, r), l.height}
+                       : Sub{joinSpine<false>(r, k, l), r.height};
+    // a red root over a red child: paint the root black, one level higher
+    const Node& root = _nodes[joined.root];
+    if (root.color() == TreeColor::RED &&
+        color(right ? root._right : root._left) == TreeColor::RED) {
+      _nodes[joined.root].setColor(TreeColor::BLACK);
+      ++joined.height;
+    }
+    return joined;
+  }
+  // down the right (Right) or left spine of tall to the first black node
+  // as high as small, which k replaces with itself over both
+  template <bool Right>
+  uint32_t joinSpine(Sub tall, uint32_t k, Sub small) {
+    uint32_t t = tall.root;
+    if (color(t) == TreeColor::BLACK && tall.height == small.height) {
+      if constexpr (Right) {
+        setChildren(k, t, small.root);
       } else {
-        rotateLeft(sibling);
-      }
-      sibling->_color = TreeColor::RED;
-      closeNephew->_color = TreeColor::BLACK;
-      sibling = node->sibling();
-      distantNephew = node->distantNephew();
-      // // update closeNephew and distantNephew
-      // if (node == parent->_left) {
-      //   closeNephew = sibling->_left;
-      //   distantNephew = sibling->_right;
-      // } else {
-      //   closeNephew = sibling->_right;
-      //   distantNephew = sibling->_left;
-      // }
-    }
-
-    // Case 5: Sibling is BLACK, distant nephew is RED
-    //   Step 1. If N is a left child, left rotate P;
-    //           If N is a right child, right rotate P.
-    //   Step 2. Swap the color of parent and sibling.
-    //   Step 3. Paint distant nephew D to BLACK.
-    //      {P}                   [S]               {S}
-    //      / \    l-rotate(P)    / \    repaint    / \
-    //    [N] [S]  ==========>  {P} <D>  ======>  [P] [D]
-    //        / \               / \               / \
-    //      {C} <D>           [N] {C}           [N] {C}
-    if (node == parent->_left) {
-      rotateLeft(parent);
+        setChildren(k, small.root, t);
+      }
+      _nodes[k].setColor(TreeColor::RED);
+      return k;
+    }
+    uint32_t outer = joinSpine<Right>(child(tall, !Right), k, small);
+    if constexpr (Right) {
+      setChildren(t, _nodes[t]._left, outer);
     } else {
-      rotateRight(parent);
+      setChildren(t, outer, _nodes[t]._right);
     }
-    std::swap(parent->_color, sibling->_color);
-    distantNephew->_color = TreeColor::BLACK;
+    uint32_t outerOuter = Right ? _nodes[outer]._right : _nodes[outer]._left;
+    if (color(t) == TreeColor::BLACK && color(outer) == TreeColor::RED &&
+        color(outerOuter) == TreeColor::RED) {
+      // t(b)                o(r)
+      //    o(r)     ==>  t(b)  oo(b)
+      //       oo(r)
+      _nodes[outerOuter].setColor(TreeColor::BLACK);
+      return rotateDetached<Right>(t);
+    }
+    return t;
   }
-  int checkEachPath(NodeSPtr node, int black_count) {
-    if (node == nullptr) {
-      black_count++;
-      return black_count;
+  // rotateLeft (Left: rotateRight) of a detached subtree; returns its new
+  // root, whose parent the caller sets
+  template <bool Left>
+  uint32_t rotateDetached(uint32_t node) {
+    if constexpr (Left) {
+      uint32_t right = _nodes[node]._right;
+      setChildren(node, _nodes[node]._left, _nodes[right]._left);
+      setChildren(right, node, _nodes[right]._right);
+      return right;
+    } else {
+      uint32_t left = _nodes[node]._left;
+      setChildren(node, _nodes[left]._right, _nodes[node]._right);
+      setChildren(left, _nodes[left]._left, node);
+      return left;
     }
-    if (node->_color == TreeColor::BLACK) {
-      black_count++;
+  }
+  // l then r, with no key between them: r joined under l's last node
+  Sub join2(Sub l, Sub r) {
+    if (l.root == kNil) {
+      return r;
     }
-    // check value
-    if ((node->_left && node->_value < node->_left->_value) ||
-        (node->_right && node->_value > node->_right->_value)) {
-      return -1;
+    auto [rest, last] = splitLast(l);
+    return join(rest, last, r);
+  }
+  std::pair<Sub, uint32_t> splitLast(Sub sub) {
+    Sub left = child(sub, true);
+    Sub right = child(sub, false);
+    if (right.root == kNil) {
+      return {left, sub.root};
     }
-    // check color of node and children
-    if (node->_color == TreeColor::RED && node->_left && node->_right &&
-        (node->_left->_color == TreeColor::RED &&
-         node->_right->_color == TreeColor::RED)) {
-      return -1;
+    auto [rest, last] = splitLast(right);
+    return {join(left, sub.root, rest), last};
+  }
+  // the keys below key, the node holding key if any, and the keys above.
+  // each level joins what it cut off back on, O(log n) in all.
+  template <typename K>
+  Split splitAt(Sub sub, const K& key) {
+    if (sub.root == kNil) {
+      return {};
     }
-    auto leftCount = checkEachPath(node->_left, black_count);
-    auto rightCount = checkEachPath(node->_right, black_count);
-    // check black count
-    return leftCount == rightCount ? leftCount : -1;
+    Sub left = child(sub, true);
+    Sub right = child(sub, false);
+    const Key& cur = keyOf(_nodes[sub.root]._value);
+    if (_compare(key, cur)) {
+      Split parts = splitAt(left, key);
+      parts.right = join(parts.right, sub.root, right);
+      return parts;
+    }
+    if (_compare(cur, key)) {
+      Split parts = splitAt(right, key);
+      parts.left = join(left, sub.root, parts.left);
+      return parts;
+    }
+    return {left, sub.root, right};
   }
-  void fixupAfterInsert(NodeSPtr node) {
-    // then rotate or change color to keep balance
 
-    // case1 tree is empty. only insert RED node.
-    // fine, is ok.
-    if (node == _root) {
+  void discard(Garbage& garbage, uint32_t node) {
+    _nodes[node]._left = garbage.head;
+    garbage.head = node;
+    if (garbage.tail == kNil) {
+      garbage.tail = node;
+    }
+    ++garbage.count;
+  }
+  void discardAll(Garbage& garbage, uint32_t node) {
+    if (node == kNil) {
       return;
     }
-    if (node->_parent == _root) {
-      // need to change root color to black
-      if (_root->_color == TreeColor::RED) [[unlikely]] {
-        _root->_color = TreeColor::BLACK;
-        return;
-      }
+    uint32_t right = _nodes[node]._right;
+    discardAll(garbage, _nodes[node]._left);
+    discardAll(garbage, right);
+    discard(garbage, node);
+  }
+  void splice(Garbage& into, Garbage& from) {
+    if (from.head == kNil) {
       return;
     }
+    _nodes[from.tail]._left = into.head;
+    into.head = from.head;
+    if (into.tail == kNil) {
+      into.tail = from.tail;
+    }
+    into.count += from.count;
+  }
+  void release(Garbage& garbage) {
+    for (uint32_t node = garbage.head; node != kNil;) {
+      uint32_t next = _nodes[node]._left;
+      drop(node);
+      node = next;
+    }
+  }
 
-    // case3 only 2 node and  black root node in tree.
-    // fine, is ok.
-    if (_count == 2 && _root->_color == TreeColor::BLACK) {
-      return;
+  // a copy of other's values in this arena, as a detached tree
+  Sub adopt(const RBTree& other) {
+    std::vector<Value> values;
+    values.reserve(other._count);
+    other.forEachNode(other._root, [&](uint32_t node) {
+      values.push_back(other._nodes[node]._value);
+    });
+    if (values.empty()) {
+      return {};
     }
+    int redDepth = std::bit_width(values.size()) - 1;
+    uint32_t root = buildSpan(values, 0, values.size(), kNil, 0, redDepth);
+    return {root, blackHeight(root)};
+  }
+  // empties the tree; the caller holds the lock
+  void clearLocked() {
+    Garbage garbage;
+    discardAll(garbage, _root);
+    release(garbage);
+    _root = kNil;
+    _count = 0;
+  }
 
-    auto parent = node->_parent;
-    assert(parent != nullptr);
-    auto grandParent = parent->_parent;
-    assert(grandParent != nullptr);
+  template <SetOp Op>
+  std::size_t combine(const RBTree& other, unsigned threads) {
+    if (&other == this) {
+      if constexpr (Op != SetOp::Difference) {
+        return 0;
+      } else {
+        std::lock_guard<std::mutex> lock(_mutex);
+        WriteSection section(*this);
+        std::size_t removed = _count;
+        clearLocked();
+        return removed;
+      }
+    }
+    std::scoped_lock lock(_mutex, other._mutex);
+    WriteSection section(*this);
+    std::size_t before = _count;
+    Sub theirs = adopt(other);
+    Garbage garbage;
+    Sub result = combine<Op>(Sub{_root, blackHeight(_root)},
+                             theirs,
+                             garbage,
+                             std::max(threads, 1U));
+    release(garbage);
+    setRoot(result.root);
+    _count = before + other._count - garbage.count;
+    return Op == SetOp::Union ? _count - before : before - _count;
+  }
+  // ours split around their root, the halves combined, possibly on two
+  // threads, and joined back around the node kept for that key, if any
+  template <SetOp Op>
+  Sub combine(Sub ours, Sub theirs, Garbage& garbage, unsigned threads) {
+    if (theirs.root == kNil) {
+      if constexpr (Op == SetOp::Intersection) {
+        discardAll(garbage, ours.root);
+        return {};
+      }
+      return ours;
+    }
+    if (ours.root == kNil) {
+      if constexpr (Op == SetOp::Union) {
+        return theirs;
+      }
+      discardAll(garbage, theirs.root);
+      return {};
+    }
+    uint32_t pivot = theirs.root;
+    Sub theirLeft = child(theirs, true);
+    Sub theirRight = child(theirs, false);
+    Split parts = splitAt(ours, keyOf(_nodes[pivot]._value));
 
-    // if P is black, insert is ok. so wo only need to consider is U.
-    if (parent->_color == TreeColor::BLACK) {
-      return;
+    Sub left;
+    Sub right;
+    bool forked = false;
+    if (threads > 1 && theirs.height >= kForkHeight) {
+      unsigned half = threads / 2;
+      Garbage rightGarbage;
+      try {
+        std::thread task([&] {
+          right = combine<Op>(
+            parts.right, theirRight, rightGarbage, threads - half);
+        });
+        left = combine<Op>(parts.left, theirLeft, garbage, half);
+        task.join();
+        splice(garbage, rightGarbage);
+        forked = true;
+      } catch (const std::system_error&) {
+        // no thread to be had: do both here
+      }
+    }
+    if (!forked) {
+      left = combine<Op>(parts.left, theirLeft, garbage, 1);
+      right = combine<Op>(parts.right, theirRight, garbage, 1);
     }
 
-    // if U is not exist
-    // if (grandParent->_left == nullptr) {
-    //   rotateLeft(grandParent);
-    //   grandParent->_color = TreeColor::RED;
-    //   parent->_color = TreeColor::BLACK;
-    //   return;
-    // } else if (grandParent->_right == nullptr) {
-    //   rotateRight(grandParent);
-    //   grandParent->_color = TreeColor::RED;
-    //   parent->_color = TreeColor::BLACK;
-    //   return;
-    // }
-
-    // case4 if U is red.
-    //      G(b)              G(r)
-    //   P(r)  U(r)  ===>  P(b)  U(b)
-    // N(r)               N(r)
-    // need change color of G, P, U.  G'parent is unknow ,so recursively recolor
-    if (grandParent->_left && grandParent->_right &&
-        grandParent->_left->_color == TreeColor::RED &&
-        grandParent->_right->_color == TreeColor::RED) {
-      // recolor(node);
-      grandParent->_color = TreeColor::RED;
-      grandParent->_left->_color = TreeColor::BLACK;
-      grandParent->_right->_color = TreeColor::BLACK;
-      fixupAfterInsert(grandParent);
+    if constexpr (Op == SetOp::Union) {
+      if (parts.match != kNil) {
+        discard(garbage, pivot);
+        return join(left, parts.match, right);
+      }
+      return join(left, pivot, right);
+    } else if constexpr (Op == SetOp::Intersection) {
+      discard(garbage, pivot);
+      if (parts.match != kNil) {
+        return join(left, parts.match, right);
+      }
+      return join2(left, right);
+    } else {
+      discard(garbage, pivot);
+      if (parts.match != kNil) {
+        discard(garbage, parts.match);
+      }
+      return join2(left, right);
+    }
+  }
+
+  // in order, by parent links
+  template <typename Func>
+  void forEachNode(uint32_t node, Func func) const {
+    if (node == kNil) {
       return;
     }
-    // if U is balck, according to the order of node, parent, grandParent
-    // LL RR LR RL
+    for (node = findLeftestNode(node); node != kNil; node = successor(node)) {
+      func(node);
+    }
+  }
 
-    // case5 LR && RL.
-    //      G(b)   L-rotate     G(b)
-    //   P(r)  U(b)  ===>    P(r)  U(b)
-    //     N(r)           N(r)
-    // need rotate to trans case6
-    if (node == parent->_right && parent == grandParent->_left) {
-      rotateLeft(parent);
-      // update node and parent for case6
-      std::swap(parent, node);
-    } else if (node == parent->_left && parent == grandParent->_right) {
-      rotateRight(parent);
-      std::swap(parent, node);
+  uint32_t successor(uint32_t node) const {
+    if (_nodes[node]._right != kNil) {
+      return findLeftestNode(_nodes[node]._right);
+    }
+    uint32_t parent = _nodes[node].parent();
+    while (parent != kNil && _nodes[parent]._right == node) {
+      node = parent;
+      parent = _nodes[node].parent();
+    }
+    return parent;
+  }
+  uint32_t predecessor(uint32_t node) const {
+    if (_nodes[node]._left != kNil) {
+      return findRightestNode(_nodes[node]._left);
+    }
+    uint32_t parent = _nodes[node].parent();
+    while (parent != kNil && _nodes[parent]._left == node) {
+      node = parent;
+      parent = _nodes[node].parent();
     }
+    return parent;
+  }
 
-    // case6 LL && RR.  RR is dual operation of LL
-    //      G(b)   R-rotate   P(r)      recolor   P(b)
-    //   P(r)  U(b)  ===>  N(r)  G(b)     ===>  N(r)  G(r)
-    // N(r)                        U(b)                  U(b)
-    if (node == parent->_left && parent == grandParent->_left) {
-      rotateRight(grandParent);
-    } else if (node == parent->_right && parent == grandParent->_right) {
-      rotateLeft(grandParent);
+  // the first node not less than key (upper: greater than key)
+  template <bool Upper, typename K>
+  uint32_t bound(const K& key) const {
+    uint32_t node = _root;
+    uint32_t result = kNil;
+    while (node != kNil) {
+      const Node& cur = _nodes[node];
+      bool goLeft = Upper ? _compare(key, keyOf(cur._value))
+                          : !_compare(keyOf(cur._value), key);
+      if (goLeft) {
+        result = node;
+        node = cur._left;
+      } else {
+        node = cur._right;
+      }
     }
-    grandParent->_color = TreeColor::RED;
-    parent->_color = TreeColor::BLACK;
+    return result;
   }
-  void swapNodePtr(NodeSPtr& lhs, NodeSPtr& rhs) {
-    std::swap(lhs->_value, rhs->_value);
-    std::swap(lhs, rhs);
+
+  template <typename K>
+  uint32_t locate(const K& key) const {
+    uint32_t node = _root;
+    while (node != kNil) {
+      const Node& cur = _nodes[node];
+      if (_compare(key, keyOf(cur._value))) {
+        node = cur._left;
+      } else if (_compare(keyOf(cur._value), key)) {
+        node = cur._right;
+      } else {
+        return node;
+      }
+    }
+    return kNil;
   }
 
- private:
-  NodeSPtr _root{};
-  std::atomic<size_t> _count = 0;
-  std::mutex _mutex{};
+  uint32_t findLeftestNode(uint32_t node) const {
+    while (_nodes[node]._left != kNil) {
+      node = _nodes[node]._left;
+    }
+    return node;
+  }
+  uint32_t findRightestNode(uint32_t node) const {
+    while (_nodes[node]._right != kNil) {
+      node = _nodes[node]._right;
+    }
+    return node;
+  }
+
+  // takes node out of the tree and rebalances; the node stays allocated
+  void unlink(uint32_t node) {
+    // y is the node that leaves its position: node itself, or its successor
+    // when node has two children. x takes y's old place.
+    uint32_t y = node;
+    TreeColor removed = color(y);
+    uint32_t x;
+    // every ancestor of y's old position loses one node; when y moves up
+    // into node's place it takes node's (already reduced) size
+    if (_nodes[node]._left != kNil && _nodes[node]._right != kNil) {
+      resizePath(_nodes[findLeftestNode(_nodes[node]._right)].parent(), -1);
+    } else {
+      resizePath(_nodes[node].parent(), -1);
+    }
+    if (_nodes[node]._left == kNil) {
+      x = _nodes[node]._right;
+      transplant(node, x);
+    } else if (_nodes[node]._right == kNil) {
+      x = _nodes[node]._left;
+      transplant(node, x);
+    } else {
+      y = findLeftestNode(_nodes[node]._right);
+      removed = color(y);
+      x = _nodes[y]._right;
+      if (_nodes[y].parent() == node) {
+        _nodes[x].setParent(y);
+      } else {
+        transplant(y, x);
+        _nodes[y]._right = _nodes[node]._right;
+        _nodes[_nodes[y]._right].setParent(y);
+      }
+      transplant(node, y);
+      _nodes[y]._left = _nodes[node]._left;
+      _nodes[_nodes[y]._left].setParent(y);
+      _nodes[y].setColor(color(node));
+      if constexpr (Ranked) {
+        _nodes[y]._size = _nodes[node]._size;
+      }
+    }
+    if (removed == TreeColor::BLACK) {
+      fixupAfterRemove(x);
+    }
+    --_count;
+  }
+
+  // puts `to` where `from` hangs; to may be nil, whose parent is then set
+  void transplant(uint32_t from, uint32_t to) {
+    uint32_t parent = _nodes[from].parent();
+    if (parent == kNil) {
+      _root = to;
+    } else if (_nodes[parent]._left == from) {
+      _nodes[parent]._left = to;
+    } else {
+      _nodes[parent]._right = to;
+    }
+    _nodes[to].setParent(parent);
+  }
+
+  //     [3]                   4
+  //  1      4      ==>    3      5
+  //       2   5        1    2       6
+  //             6
+  void rotateLeft(uint32_t node) {
+    uint32_t right = _nodes[node]._right;
+    uint32_t successor = _nodes[right]._left;
+    _nodes[node]._right = successor;
+    if (successor != kNil) {
+      _nodes[successor].setParent(node);
+    }
+    transplant(node, right);
+    _nodes[right]._left = node;
+    _nodes[node].setParent(right);
+    resize(node);
+    resize(right);
+  }
+  // dual operation of rotateLeft. just swap text "right" with "left"
+  void rotateRight(uint32_t node) {
+    uint32_t left = _nodes[node]._left;
+    uint32_t successor = _nodes[left]._right;
+    _nodes[node]._left = successor;
+    if (successor != kNil) {
+      _nodes[successor].setParent(node);
+    }
+    transplant(node, left);
+    _nodes[left]._right = node;
+    _nodes[node].setParent(left);
+    resize(node);
+    resize(left);
+  }
+
+  void fixupAfterInsert(uint32_t node) {
+    // the nil parent of the root is black, which ends the loop there
+    while (color(_nodes[node].parent()) == TreeColor::RED) {
+      uint32_t parent = _nodes[node].parent();
+      uint32_t grandParent = _nodes[parent].parent();
+      bool parentIsLeft = parent == _nodes[grandParent]._left;
+      uint32_t uncle = parentIsLeft ? _nodes[grandParent]._right
+                                    : _nodes[grandParent]._left;
+      // U is red: recolor G, P, U and continue from G
+      //      G(b)              G(r)
+      //   P(r)  U(r)  ===>  P(b)  U(b)
+      // N(r)               N(r)
+      if (color(uncle) == TreeColor::RED) {
+        _nodes[parent].setColor(TreeColor::BLACK);
+        _nodes[uncle].setColor(TreeColor::BLACK);
+        _nodes[grandParent].setColor(TreeColor::RED);
+        node = grandParent;
+        continue;
+      }
+      // U is black. LR and RL rotate into LL and RR first
+      if (parentIsLeft && node == _nodes[parent]._right) {
+        rotateLeft(parent);
+        std::swap(node, parent);
+      } else if (!parentIsLeft && node == _nodes[parent]._left) {
+        rotateRight(parent);
+        std::swap(node, parent);
+      }
+      //      G(b)   R-rotate   P(r)      recolor   P(b)
+      //   P(r)  U(b)  ===>  N(r)  G(b)     ===>  N(r)  G(r)
+      // N(r)                        U(b)                  U(b)
+      if (parentIsLeft) {
+        rotateRight(grandParent);
+      } else {
+        rotateLeft(grandParent);
+      }
+      _nodes[parent].setColor(TreeColor::BLACK);
+      _nodes[grandParent].setColor(TreeColor::RED);
+      break;
+    }
+    _nodes[_root].setColor(TreeColor::BLACK);
+  }
+
+  // node carries an extra black after a black node was unlinked above it
+  void fixupAfterRemove(uint32_t node) {
+    while (node != _root && color(node) == TreeColor::BLACK) {
+      uint32_t parent = _nodes[node].parent();
+      bool isLeft = node == _nodes[parent]._left;
+      uint32_t sibling = isLeft ? _nodes[parent]._right : _nodes[parent]._left;
+      // Case 1: sibling is red. rotate it above parent, goto case 2, 3, 4
+      if (color(sibling) == TreeColor::RED) {
+        _nodes[sibling].setColor(TreeColor::BLACK);
+        _nodes[parent].setColor(TreeColor::RED);
+        if (isLeft) {
+          rotateLeft(parent);
+          sibling = _nodes[parent]._right;
+        } else {
+          rotateRight(parent);
+          sibling = _nodes[parent]._left;
+        }
+      }
+      uint32_t close = isLeft ? _nodes[sibling]._left : _nodes[sibling]._right;
+      uint32_t distant =
+        isLeft ? _nodes[sibling]._right : _nodes[sibling]._left;
+      // Case 2: both nephews black. paint sibling red, move the extra black up
+      if (color(close) == TreeColor::BLACK &&
+          color(distant) == TreeColor::BLACK) {
+        _nodes[sibling].setColor(TreeColor::RED);
+        node = parent;
+        continue;
+      }
+      // Case 3: close nephew red, distant black. rotate sibling, goto case 4
+      if (color(distant) == TreeColor::BLACK) {
+        _nodes[close].setColor(TreeColor::BLACK);
+        _nodes[sibling].setColor(TreeColor::RED);
+        if (isLeft) {
+          rotateRight(sibling);
+        } else {
+          rotateLeft(sibling);
+        }
+        distant = sibling;
+        sibling = close;
+      }
+      // Case 4: distant nephew red. rotate parent, and the extra black is gone
+      _nodes[sibling].setColor(color(parent));
+      _nodes[parent].setColor(TreeColor::BLACK);
+      _nodes[distant].setColor(TreeColor::BLACK);
+      if (isLeft) {
+        rotateLeft(parent);
+      } else {
+        rotateRight(parent);
+      }
+      node = _root;
+    }
+    _nodes[node].setColor(TreeColor::BLACK);
+  }
+
+  int checkEachPath(uint32_t node, uint32_t parent, int black_count) const {
+    if (node == kNil) {
+      return black_count + 1;
+    }
+    const Node& cur = _nodes[node];
+    if (cur.parent() != parent) {
+      return -1;
+    }
+    if (cur.color() == TreeColor::BLACK) {
+      black_count++;
+    }
+    // check value
+    const Key& key = keyOf(cur._value);
+    if ((cur._left != kNil &&
+         !_compare(keyOf(_nodes[cur._left]._value), key)) ||
+        (cur._right != kNil &&
+         !_compare(key, keyOf(_nodes[cur._right]._value)))) {
+      return -1;
+    }
+    if constexpr (Ranked) {
+      if (cur._size != _nodes[cur._left]._size + _nodes[cur._right]._size + 1) {
+        return -1;
+      }
+    }
+    // a red node has no red child
+    if (cur.color() == TreeColor::RED &&
+        (color(cur._left) == TreeColor::RED ||
+         color(cur._right) == TreeColor::RED)) {
+      return -1;
+    }
+    auto leftCount = checkEachPath(cur._left, node, black_count);
+    auto rightCount = checkEachPath(cur._right, node, black_count);
+    // check black count
+    return leftCount == rightCount ? leftCount : -1;
+  }
+
+  void printNode(uint32_t node, int level, const std::string& prefix) const {
+    const Node& cur = _nodes[node];
+    std::cout << std::setw(level * 4) << prefix << keyOf(cur._value)
+              << (cur.color() == TreeColor::RED ? "(R)" : "(B)") << std::endl;
+    if (cur._left == kNil && cur._right == kNil) {
+      return;
+    }
+    for (auto [child, label] : {std::pair{cur._left, "L--- "},
+                                std::pair{cur._right, "R--- "}}) {
+      if (child != kNil) {
+        printNode(child, level + 1, label);
+      } else {
+        std::cout << std::setw((level + 1) * 4) << label << "None"
+                  << std::endl;
+      }
+    }
+  }
+
+  NodeArena<Node> _nodes;
+  Link _root = kNil;
+  std::atomic<uint64_t> _seq = 0;
+  std::atomic<std::size_t> _count = 0;
+  [[no_unique_address]] Compare _compare{};
+  mutable std::mutex _mutex{};
 };
+
+// an ordered map on the same arena tree: values are std::pair<const Key, T>
+// ordered by Compare on the key. find, emplace and try_emplace return the
+// entry mutable; iterators still yield it const.
+template <typename Key,
+          typename T,
+          typename Compare = std::less<Key>,
+          bool Ranked = false>
+using RBMap = RBTree<std::pair<const Key, T>,
+                     Compare,
+                     ReadMode::Locked,
+                     Ranked,
+                     detail::FirstOf>;
 }  // namespace rbtree
-}  // namespace lz
\ No newline at end of file
+}  // namespace lz
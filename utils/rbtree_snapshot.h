@@ -0,0 +1,384 @@
+/*
+ * @Description: RBTree values saved as a flat file that is mapped and
+ * searched in place
+ * @Author: lize
+ * @Date: 2025-11-10
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "rbtree.h"
+namespace lz {
+namespace rbtree {
+// how the values are ordered in the file
+enum class SnapshotLayout : uint32_t {
+  // ascending: a binary search, and scans read the file front to back
+  Sorted = 0,
+  // the implicit tree of a binary search stored breadth-first from slot 1,
+  // so node k has children 2k and 2k + 1. the top levels share a few
+  // cache lines, and the 16 nodes four levels below k are one aligned
+  // block that a search prefetches while it compares. scans jump around.
+  Eytzinger = 1,
+};
+
+namespace detail {
+// the file starts with this and the values follow at _offset, in the byte
+// order and the Value layout of the writer. loading checks both.
+struct SnapshotHeader {
+  static constexpr char kMagic[8] = {'l', 'z', 'r', 'b', 's', 'n', 'a', 'p'};
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kByteOrder = 0x01020304;
+  // a cache line, so Eytzinger blocks are line aligned in the mapping
+  static constexpr uint64_t kValuesOffset = 64;
+
+  char _magic[8];
+  uint32_t _version;
+  uint32_t _byteOrder;
+  uint32_t _layout;
+  uint32_t _valueSize;
+  uint32_t _valueAlign;
+  uint32_t _reserved;
+  uint64_t _count;
+  uint64_t _offset;
+};
+static_assert(sizeof(SnapshotHeader) <= SnapshotHeader::kValuesOffset);
+
+// Eytzinger slots of a tree of n nodes in ascending order; 0 is the end
+inline std::size_t eytzingerFirst(std::size_t n) {
+  return n == 0 ? 0 : std::bit_floor(n);
+}
+inline std::size_t eytzingerNext(std::size_t k, std::size_t n) {
+  if (2 * k + 1 <= n) {
+    k = 2 * k + 1;
+    while (2 * k <= n) {
+      k *= 2;
+    }
+    return k;
+  }
+  // up past every ancestor we are the right child of, then one more
+  return k >> (std::countr_one(k) + 1);
+}
+
+// a whole file mapped read-only
+class FileMapping {
+ public:
+  explicit FileMapping(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      fail("cannot open", path);
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      _size = static_cast<std::size_t>(size.QuadPart);
+      mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (mapping == nullptr) {
+      fail("cannot map", path);
+    }
+    _base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (_base == nullptr) {
+      fail("cannot map", path);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fail("cannot open", path);
+    }
+    struct stat info;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      _size = static_cast<std::size_t>(info.st_size);
+      base = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      fail("cannot map", path);
+    }
+    _base = base;
+#endif
+  }
+  FileMapping(FileMapping&& other) noexcept
+    : _base(std::exchange(other._base, nullptr)),
+      _size(std::exchange(other._size, 0)) {
+  }
+  FileMapping& operator=(FileMapping other) noexcept {
+    std::swap(_base, other._base);
+    std::swap(_size, other._size);
+    return *this;
+  }
+  ~FileMapping() {
+    if (_base == nullptr) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(_base);
+#else
+    munmap(_base, _size);
+#endif
+  }
+
+  const char* data() const {
+    return static_cast<const char*>(_base);
+  }
+  std::size_t size() const {
+    return _size;
+  }
+
+ private:
+  [[noreturn]] static void fail(const char* what,
+                                const std::filesystem::path& path) {
+    throw std::runtime_error(std::string("rbtree snapshot: ") + what + " " +
+                             path.string());
+  }
+
+  void* _base = nullptr;
+  std::size_t _size = 0;
+};
+}  // namespace detail
+
+// writes ascending, unique values to path. the file is written beside path
+// and renamed over it, so a reader never maps half a snapshot. throws
+// std::runtime_error if it cannot be written.
+template <typename Value>
+void saveSnapshot(std::span<const Value> sorted,
+                  const std::filesystem::path& path,
+                  SnapshotLayout layout = SnapshotLayout::Eytzinger) {
+  static_assert(std::is_trivially_copyable_v<Value>,
+                "snapshots store values as raw bytes");
+  using Header = detail::SnapshotHeader;
+  Header header{};
+  std::memcpy(header._magic, Header::kMagic, sizeof(header._magic));
+  header._version = Header::kVersion;
+  header._byteOrder = Header::kByteOrder;
+  header._layout = static_cast<uint32_t>(layout);
+  header._valueSize = sizeof(Value);
+  header._valueAlign = alignof(Value);
+  header._count = sorted.size();
+  header._offset = Header::kValuesOffset;
+
+  auto temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    char head[Header::kValuesOffset] = {};
+    std::memcpy(head, &header, sizeof(header));
+    out.write(head, sizeof(head));
+    auto write = [&](const Value* values, std::size_t count) {
+      out.write(reinterpret_cast<const char*>(values), count * sizeof(Value));
+    };
+    if (layout == SnapshotLayout::Sorted) {
+      write(sorted.data(), sorted.size());
+    } else {
+      // slot 0 is padding, so block k * 16 starts on a line
+      std::vector<Value> slots(sorted.size() + 1);
+      std::memset(static_cast<void*>(slots.data()), 0, sizeof(Value));
+      std::size_t n = sorted.size();
+      for (std::size_t k = detail::eytzingerFirst(n), i = 0; k != 0;
+           k = detail::eytzingerNext(k, n)) {
+        slots[k] = sorted[i++];
+      }
+      write(slots.data(), slots.size());
+    }
+    out.close();
+    if (!out) {
+      throw std::runtime_error("rbtree snapshot: cannot write " +
+                               temporary.string());
+    }
+  }
+  std::filesystem::rename(temporary, path);
+}
+// saves the values of tree, copied out under its lock
+template <typename Value, typename Compare, ReadMode Mode, bool Ranked>
+void saveSnapshot(const RBTree<Value, Compare, Mode, Ranked>& tree,
+                  const std::filesystem::path& path,
+                  SnapshotLayout layout = SnapshotLayout::Eytzinger) {
+  std::vector<Value> sorted;
+  sorted.reserve(tree.size());
+  tree.for_each([&](const Value& value) { sorted.push_back(value); });
+  saveSnapshot(std::span<const Value>(sorted), path, layout);
+}
+
+// a saved snapshot mapped read-only. opening reads one header; queries
+// search the mapped values where they lie, so the OS pages in only what
+// they touch. Compare must be the order the values were saved in.
+template <typename Value, typename Compare = std::less<Value>>
+class MappedSnapshot {
+  static_assert(std::is_trivially_copyable_v<Value>,
+                "snapshots store values as raw bytes");
+
+ public:
+  // throws std::runtime_error if path is not a snapshot of this Value
+  explicit MappedSnapshot(const std::filesystem::path& path)
+    : _file(path) {
+    using Header = detail::SnapshotHeader;
+    Header header;
+    if (_file.size() < sizeof(header)) {
+      invalid(path);
+    }
+    std::memcpy(&header, _file.data(), sizeof(header));
+    if (std::memcmp(header._magic, Header::kMagic, sizeof(header._magic)) !=
+          0 ||
+        header._version != Header::kVersion ||
+        header._byteOrder != Header::kByteOrder ||
+        header._valueSize != sizeof(Value) ||
+        header._valueAlign != alignof(Value) ||
+        header._offset % alignof(Value) != 0 ||
+        header._offset > _file.size() ||
+        header._layout > static_cast<uint32_t>(SnapshotLayout::Eytzinger)) {
+      invalid(path);
+    }
+    _layout = static_cast<SnapshotLayout>(header._layout);
+    std::size_t slots = (_file.size() - header._offset) / sizeof(Value);
+    std::size_t padding = _layout == SnapshotLayout::Eytzinger ? 1 : 0;
+    if (slots < padding || header._count > slots - padding) {
+      invalid(path);
+    }
+    _count = header._count;
+    _values = reinterpret_cast<const Value*>(_file.data() + header._offset);
+  }
+
+  // the mapped value, or nullptr
+  const Value* find(const Value& value) const {
+    std::size_t slot = lowerBound(value);
+    return slot == end() || _compare(value, _values[slot]) ? nullptr
+                                                           : &_values[slot];
+  }
+  bool contains(const Value& value) const {
+    return find(value) != nullptr;
+  }
+  const Value* findMin() const {
+    return _count == 0 ? nullptr : &_values[first()];
+  }
+
+  // func(value) for every value in [lo, hi), ascending. returns how many
+  // values were visited.
+  template <typename Func>
+  std::size_t for_each_in_range(const Value& lo,
+                                const Value& hi,
+                                Func&& func) const {
+    std::size_t visited = 0;
+    for (std::size_t slot = lowerBound(lo);
+         slot != end() && _compare(_values[slot], hi);
+         slot = next(slot)) {
+      func(_values[slot]);
+      ++visited;
+    }
+    return visited;
+  }
+  template <typename Func>
+  std::size_t for_each(Func&& func) const {
+    for (std::size_t slot = first(); slot != end(); slot = next(slot)) {
+      func(_values[slot]);
+    }
+    return _count;
+  }
+
+  // a mutable tree of the values, built bottom-up in O(n)
+  template <ReadMode Mode = ReadMode::Locked, bool Ranked = false>
+  RBTree<Value, Compare, Mode, Ranked> toTree() const {
+    using Tree = RBTree<Value, Compare, Mode, Ranked>;
+    if (_layout == SnapshotLayout::Sorted) {
+      return Tree::fromSorted(std::span<const Value>(_values, _count));
+    }
+    std::vector<Value> sorted;
+    sorted.reserve(_count);
+    for_each([&](const Value& value) { sorted.push_back(value); });
+    return Tree::fromSorted(sorted);
+  }
+
+  std::size_t size() const {
+    return _count;
+  }
+  bool empty() const {
+    return _count == 0;
+  }
+  SnapshotLayout layout() const {
+    return _layout;
+  }
+  // the file, header included
+  std::size_t bytes() const {
+    return _file.size();
+  }
+
+ private:
+  [[noreturn]] static void invalid(const std::filesystem::path& path) {
+    throw std::runtime_error("rbtree snapshot: not a snapshot of this type: " +
+                             path.string());
+  }
+
+  // slots run 0..n-1 when Sorted, 1..n when Eytzinger, where 0 is the end
+  std::size_t end() const {
+    return _layout == SnapshotLayout::Sorted ? _count : 0;
+  }
+  std::size_t first() const {
+    return _layout == SnapshotLayout::Sorted ? 0
+                                             : detail::eytzingerFirst(_count);
+  }
+  std::size_t next(std::size_t slot) const {
+    return _layout == SnapshotLayout::Sorted
+             ? slot + 1
+             : detail::eytzingerNext(slot, _count);
+  }
+
+  // the slot of the first value not less than value, or end()
+  std::size_t lowerBound(const Value& value) const {
+    if (_layout == SnapshotLayout::Sorted) {
+      return std::lower_bound(_values, _values + _count, value, _compare) -
+             _values;
+    }
+    // descend without branching on the comparison; the slots to the right
+    // of the last left turn hold the answer
+    std::size_t k = 1;
+    while (k <= _count) {
+      if (k * 16 <= _count) {
+        detail::prefetch(_values + k * 16);
+      }
+      k = 2 * k + _compare(_values[k], value);
+    }
+    return k >> (std::countr_one(k) + 1);
+  }
+
+  detail::FileMapping _file;
+  const Value* _values = nullptr;
+  std::size_t _count = 0;
+  SnapshotLayout _layout = SnapshotLayout::Sorted;
+  [[no_unique_address]] Compare _compare{};
+};
+}  // namespace rbtree
+}  // namespace lz
@@ -0,0 +1,514 @@
+/*
+ * @Description: scoped latency probes: rdtscp spans into per-thread rings,
+ * drained by a collector into histograms and flame graph stacks
+ * @Author: lize
+ * @Date: 2025-11-17
+ * @LastEditors: lize
+ */
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "time.h"
+#include "trace_scope.h"
+
+namespace lz {
+namespace trace {
+// one probe span, in TSC ticks. depth is how many spans were open on the
+// thread around it, which is enough to rebuild the stacks.
+struct Record {
+  uint64_t start;
+  uint64_t end;
+  uint32_t probe;
+  uint32_t depth;
+};
+
+// HDR-style log-linear histogram: values below 2^kSubBits have a bucket
+// each; above, every power of two is cut into 2^kSubBits equal buckets, so
+// any value is known to within 1 / 2^kSubBits (under 1%), from 1 ns to
+// centuries, in 58 KB.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBits = 7;
+  static constexpr std::size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+  void record(uint64_t value, uint64_t times = 1) {
+    _counts[bucket(value)] += times;
+    _count += times;
+    _sum += value * times;
+    _min = std::min(_min, value);
+    _max = std::max(_max, value);
+  }
+  void merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      _counts[i] += other._counts[i];
+    }
+    _count += other._count;
+    _sum += other._sum;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+  }
+
+  // the least value v with at least p of the values at or below v, as the
+  // highest value of its bucket, capped at max(). p in [0, 1].
+  uint64_t percentile(double p) const {
+    if (_count == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(_count) + 0.5);
+    rank = std::clamp<uint64_t>(rank, 1, _count);
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      seen += _counts[i];
+      if (seen >= rank) {
+        return std::min(highest(i), _max);
+      }
+    }
+    return _max;
+  }
+  uint64_t count() const {
+    return _count;
+  }
+  uint64_t min() const {
+    return _count == 0 ? 0 : _min;
+  }
+  uint64_t max() const {
+    return _max;
+  }
+  double mean() const {
+    return _count == 0 ? 0 : static_cast<double>(_sum) / _count;
+  }
+
+  static std::size_t bucket(uint64_t value) {
+    int width = static_cast<int>(std::bit_width(value));
+    int shift = std::max(width - kSubBits - 1, 0);
+    return (static_cast<std::size_t>(shift) << kSubBits) + (value >> shift);
+  }
+  static uint64_t highest(std::size_t bucket) {
+    if (bucket < (std::size_t{2} << kSubBits)) {
+      return bucket;
+    }
+    int shift = static_cast<int>(bucket >> kSubBits) - 1;
+    uint64_t sub = (bucket & ((1U << kSubBits) - 1)) | (1U << kSubBits);
+    return ((sub + 1) << shift) - 1;
+  }
+
+ private:
+  std::array<uint64_t, kBuckets> _counts{};
+  uint64_t _count = 0;
+  uint64_t _sum = 0;
+  uint64_t _min = UINT64_MAX;
+  uint64_t _max = 0;
+};
+
+// single producer, single consumer: the thread that owns it pushes, the
+// collector drains. a full ring drops the record and counts it rather than
+// wait.
+class ThreadRing {
+ public:
+  static constexpr std::size_t kCapacity = 1 << 14;
+
+  explicit ThreadRing(uint32_t thread) : _thread(thread) {
+  }
+
+  void push(const Record& record) {
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tailSeen >= kCapacity) {
+      _tailSeen = _tail.load(std::memory_order_acquire);
+      if (head - _tailSeen >= kCapacity) {
+        _dropped.store(_dropped.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        return;
+      }
+    }
+    _records[head & (kCapacity - 1)] = record;
+    _head.store(head + 1, std::memory_order_release);
+  }
+  // func(record) for every record pushed since the last drain, in order
+  template <typename Func>
+  std::size_t drain(Func&& func) {
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    uint64_t head = _head.load(std::memory_order_acquire);
+    for (uint64_t i = tail; i != head; ++i) {
+      func(_records[i & (kCapacity - 1)]);
+    }
+    _tail.store(head, std::memory_order_release);
+    return head - tail;
+  }
+
+  uint32_t thread() const {
+    return _thread;
+  }
+  uint64_t dropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+  // set when the thread exits; the collector frees the ring once drained
+  std::atomic<bool> _retired{false};
+  // spans open on the thread, touched by that thread only
+  uint32_t _depth = 0;
+
+ private:
+  alignas(64) std::atomic<uint64_t> _head{0};
+  uint64_t _tailSeen = 0;
+  std::atomic<uint64_t> _dropped{0};
+  alignas(64) std::atomic<uint64_t> _tail{0};
+  alignas(64) std::array<Record, kCapacity> _records;
+  uint32_t _thread;
+};
+
+// probe names and the rings of every thread that ever hit a probe
+class Registry {
+ public:
+  static Registry& instance() {
+    static Registry registry;
+    return registry;
+  }
+
+  // the same name gets the same id, however many call sites use it
+  uint32_t intern(const char* name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = std::find(_names.begin(), _names.end(), name);
+    if (found != _names.end()) {
+      return static_cast<uint32_t>(found - _names.begin());
+    }
+    _names.emplace_back(name);
+    return static_cast<uint32_t>(_names.size() - 1);
+  }
+  std::string name(uint32_t probe) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return probe < _names.size() ? _names[probe] : "?";
+  }
+
+  std::shared_ptr<ThreadRing> attach() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_collectors == 0) {
+      pruneRetired();
+    }
+    auto ring = std::make_shared<ThreadRing>(_nextThread++);
+    _rings.push_back(ring);
+    return ring;
+  }
+  // the thread of ring exits. with no collector to drain it one last time,
+  // its records are of no use and the ring goes now.
+  void detach(const std::shared_ptr<ThreadRing>& ring) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ring->_retired.store(true, std::memory_order_release);
+    if (_collectors == 0) {
+      std::erase(_rings, ring);
+    }
+  }
+  // collectors say they are there, so that rings wait to be drained
+  void addCollector() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_collectors;
+  }
+  void removeCollector() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    --_collectors;
+  }
+  // rings kept, retired ones included
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _rings.size();
+  }
+  // the rings to drain; retired ones are dropped from the registry here,
+  // and drained one last time by the caller
+  std::vector<std::shared_ptr<ThreadRing>> rings() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::shared_ptr<ThreadRing>> rings = _rings;
+    pruneRetired();
+    return rings;
+  }
+
+  // one collector drains at a time: the rings have a single consumer
+  std::mutex _drainMutex;
+
+ private:
+  Registry() = default;
+
+  void pruneRetired() {
+    std::erase_if(_rings, [](const auto& ring) {
+      return ring->_retired.load(std::memory_order_acquire);
+    });
+  }
+
+  mutable std::mutex _mutex;
+  std::vector<std::string> _names;
+  std::vector<std::shared_ptr<ThreadRing>> _rings;
+  uint32_t _nextThread = 0;
+  int _collectors = 0;
+};
+
+namespace detail {
+// the calling thread's ring: set on first use, cleared when the thread
+// exits. plain pointers, so the hot path has no TLS initialization check.
+inline thread_local ThreadRing* tlsRing = nullptr;
+inline thread_local bool tlsExited = false;
+}  // namespace detail
+
+// the calling thread's ring, attached on first use and detached when the
+// thread exits; nullptr after that, for probes in thread_local destructors
+inline ThreadRing* threadRing() {
+  struct Owner {
+    std::shared_ptr<ThreadRing> ring = Registry::instance().attach();
+    ~Owner() {
+      detail::tlsRing = nullptr;
+      detail::tlsExited = true;
+      Registry::instance().detach(ring);
+    }
+  };
+  if (detail::tlsRing == nullptr) [[unlikely]] {
+    if (detail::tlsExited) {
+      return nullptr;
+    }
+    thread_local Owner owner;
+    detail::tlsRing = owner.ring.get();
+  }
+  return detail::tlsRing;
+}
+
+class Probe {
+ public:
+  explicit Probe(const char* name) : _id(Registry::instance().intern(name)) {
+  }
+  uint32_t id() const {
+    return _id;
+  }
+
+ private:
+  uint32_t _id;
+};
+
+// times its own lifetime with rdtscp, which waits for the work before it
+// average cost 2 * rdtscp + 5ns
+class Scope {
+ public:
+  explicit Scope(const Probe& probe)
+      : _ring(threadRing()),
+        _probe(probe.id()),
+        _depth(_ring != nullptr ? _ring->_depth++ : 0) {
+    _start = rdtscp();
+  }
+  ~Scope() {
+    uint64_t end = rdtscp();
+    if (_ring != nullptr) {
+      --_ring->_depth;
+      _ring->push({_start, end, _probe, _depth});
+    }
+  }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  ThreadRing* _ring;
+  uint32_t _probe;
+  uint32_t _depth;
+  uint64_t _start;
+};
+
+// drains every ring each interval on a thread of its own and rewrites two
+// files:
+//   <prefix>.txt: count, mean and percentiles of each probe, in ns
+//   <prefix>.folded: "thread;outer;inner self-ns" lines, the input of
+//     flamegraph.pl and speedscope
+// everything is kept from the start, so each dump covers the whole run.
+// the destructor drains and dumps one last time.
+class Collector {
+ public:
+  explicit Collector(std::filesystem::path prefix,
+                     std::chrono::milliseconds interval =
+                       std::chrono::seconds(1))
+      : _prefix(std::move(prefix)), _interval(interval) {
+    TscClock::calibrate();
+    Registry::instance().addCollector();
+    _thread = std::thread([this] { run(); });
+  }
+  ~Collector() {
+    {
+      std::lock_guard<std::mutex> lock(_stopMutex);
+      _stop = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+    flush();
+    Registry::instance().removeCollector();
+  }
+  Collector(const Collector&) = delete;
+  Collector& operator=(const Collector&) = delete;
+
+  // drains and dumps now
+  void flush() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    drain();
+    dump();
+  }
+  // the histogram of a probe so far, in ns
+  LatencyHistogram histogram(const std::string& probe) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    drain();
+    for (uint32_t id = 0; id < _histograms.size(); ++id) {
+      if (_histograms[id] && Registry::instance().name(id) == probe) {
+        return *_histograms[id];
+      }
+    }
+    return {};
+  }
+
+ private:
+  // probe ids from the outermost span down
+  using Stack = std::vector<uint32_t>;
+  // a finished span whose parent has not finished yet, with the self time
+  // of the stacks below it, relative to it
+  struct Pending {
+    uint32_t depth;
+    uint64_t ticks;
+    std::map<Stack, uint64_t> folded;
+  };
+  struct ThreadState {
+    std::vector<Pending> pending;
+    uint64_t dropped = 0;
+  };
+
+  void run() {
+    std::unique_lock<std::mutex> lock(_stopMutex);
+    while (!_wake.wait_for(lock, _interval, [this] { return _stop; })) {
+      lock.unlock();
+      flush();
+      lock.lock();
+    }
+  }
+
+  void drain() {
+    Registry& registry = Registry::instance();
+    std::lock_guard<std::mutex> lock(registry._drainMutex);
+    for (auto& ring : registry.rings()) {
+      ThreadState& state = _threads[ring->thread()];
+      ring->drain([&](const Record& record) {
+        add(ring->thread(), state, record);
+      });
+      uint64_t dropped = ring->dropped();
+      _dropped += dropped - state.dropped;
+      state.dropped = dropped;
+    }
+  }
+
+  // spans end innermost first, so a span's children are the deeper spans
+  // that ended on its thread since the last span at its own depth
+  void add(uint32_t thread, ThreadState& state, const Record& record) {
+    uint64_t ticks = record.end - record.start;
+    histogramOf(record.probe).record(TscClock::toNs(ticks));
+
+    Pending span{record.depth, ticks, {}};
+    uint64_t childTicks = 0;
+    while (!state.pending.empty() &&
+           state.pending.back().depth > record.depth) {
+      Pending& child = state.pending.back();
+      childTicks += child.ticks;
+      for (auto& [stack, ns] : child.folded) {
+        Stack path{record.probe};
+        path.insert(path.end(), stack.begin(), stack.end());
+        span.folded[path] += ns;
+      }
+      state.pending.pop_back();
+    }
+    span.folded[Stack{record.probe}] +=
+      TscClock::toNs(ticks - std::min(ticks, childTicks));
+    if (record.depth > 0) {
+      state.pending.push_back(std::move(span));
+      return;
+    }
+    for (auto& [stack, ns] : span.folded) {
+      _folded[{thread, stack}] += ns;
+    }
+  }
+
+  LatencyHistogram& histogramOf(uint32_t probe) {
+    if (probe >= _histograms.size()) {
+      _histograms.resize(probe + 1);
+    }
+    if (!_histograms[probe]) {
+      _histograms[probe] = std::make_unique<LatencyHistogram>();
+    }
+    return *_histograms[probe];
+  }
+
+  // written beside and renamed over, so a reader never sees half a file
+  void dump() {
+    Registry& registry = Registry::instance();
+    write(".txt", [&](std::ofstream& out) {
+      out << std::left << std::setw(32) << "probe" << std::right;
+      for (const char* column :
+           {"count", "mean", "p50", "p90", "p99", "p99.9", "max"}) {
+        out << std::setw(12) << column;
+      }
+      out << "  (ns)\n";
+      for (uint32_t id = 0; id < _histograms.size(); ++id) {
+        auto& histogram = _histograms[id];
+        if (!histogram) {
+          continue;
+        }
+        out << std::left << std::setw(32) << registry.name(id) << std::right
+            << std::setw(12) << histogram->count() << std::setw(12)
+            << static_cast<uint64_t>(histogram->mean());
+        for (double p : {0.5, 0.9, 0.99, 0.999}) {
+          out << std::setw(12) << histogram->percentile(p);
+        }
+        out << std::setw(12) << histogram->max() << "\n";
+      }
+      out << "dropped " << _dropped << "\n";
+    });
+    write(".folded", [&](std::ofstream& out) {
+      for (auto& [where, ns] : _folded) {
+        out << "thread-" << where.first;
+        for (uint32_t probe : where.second) {
+          out << ";" << registry.name(probe);
+        }
+        out << " " << ns << "\n";
+      }
+    });
+  }
+  template <typename Func>
+  void write(const char* extension, Func&& func) {
+    auto path = _prefix;
+    path += extension;
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::trunc);
+      func(out);
+    }
+    std::error_code error;
+    std::filesystem::rename(tmp, path, error);
+  }
+
+  std::filesystem::path _prefix;
+  std::chrono::milliseconds _interval;
+  std::mutex _mutex;
+  // by probe id
+  std::vector<std::unique_ptr<LatencyHistogram>> _histograms;
+  std::map<std::pair<uint32_t, Stack>, uint64_t> _folded;
+  std::map<uint32_t, ThreadState> _threads;
+  uint64_t _dropped = 0;
+
+  std::mutex _stopMutex;
+  std::condition_variable _wake;
+  bool _stop = false;
+  std::thread _thread;
+};
+}  // namespace trace
+}  // namespace lz
@@ -0,0 +1,26 @@
+/*
+ * @Description: the LZ_TRACE_SCOPE probe macro, a no-op unless LZ_TRACE
+ * @Author: lize
+ * @Date: 2025-11-17
+ * @LastEditors: lize
+ */
+
+#pragma once
+
+// LZ_TRACE_SCOPE("rbtree.insert") times the rest of the enclosing block.
+// probes cost nothing unless LZ_TRACE is defined, so they can stay in the
+// code that production builds compile with it. only trace-enabled builds
+// pull in trace.h.
+#ifdef LZ_TRACE
+#include "trace.h"
+
+#define LZ_TRACE_CONCAT_(a, b) a##b
+#define LZ_TRACE_CONCAT(a, b) LZ_TRACE_CONCAT_(a, b)
+#define LZ_TRACE_SCOPE(name)                                        \
+  static ::lz::trace::Probe LZ_TRACE_CONCAT(lzProbe, __LINE__){name}; \
+  ::lz::trace::Scope LZ_TRACE_CONCAT(lzScope, __LINE__) {             \
+    LZ_TRACE_CONCAT(lzProbe, __LINE__)                                \
+  }
+#else
+#define LZ_TRACE_SCOPE(name) static_cast<void>(0)
+#endif